@@ -0,0 +1,434 @@
+#pragma once
+#include "ecs.h" // Entity, BitMaskHelper, CompactMask, ComponentFamily
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//
+// Archetype (table) storage backend
+//
+// Design notes:
+// - Entities with the same component mask live together in one archetype.
+// - Each archetype stores its rows in fixed-size chunks laid out as SoA:
+//     [entity ids][column 0][column 1]...   (each column `capacity` long)
+//   so a query walks contiguous arrays for every component it touches.
+// - add/remove move the entity's row to the neighbouring archetype; the
+//   archetype reached by adding/removing a given component is cached on
+//   both ends (graph edges), so steady-state moves never look up a mask.
+// - view<Ts...> matches whole archetypes by mask and then iterates their
+//   chunks; no per-entity mask tests or sparse lookups.
+// - Rows are kept packed with swap-remove, like SparseSet.
+//
+// ArchetypeECS exposes the same create_entity / destroy_entity / add / get /
+// has / remove / view API as ECS, so a world can pick either backend. Wide
+// multi-component queries favour archetypes; add/remove churn favours the
+// sparse-set ECS (a move copies every component of the entity).
+//
+// Structural changes (add/remove/destroy) during view() are not supported.
+//
+class ArchetypeECS {
+public:
+  // Target bytes per chunk (entity ids + all columns).
+  static constexpr size_t CHUNK_BYTES = 16 * 1024;
+
+  ArchetypeECS() { root = get_or_create_archetype({}); }
+  ~ArchetypeECS() = default;
+
+  ArchetypeECS(const ArchetypeECS &) = delete;
+  ArchetypeECS &operator=(const ArchetypeECS &) = delete;
+
+  // -------------------------------------------
+  // Entity management
+  // -------------------------------------------
+  Entity create_entity() {
+    uint32_t idx;
+    if (!free_list.empty()) {
+      idx = free_list.back();
+      free_list.pop_back();
+    } else {
+      idx = static_cast<uint32_t>(versions.size());
+      versions.push_back(1);
+      records.push_back({});
+    }
+    records[idx] = {root, root->push_row(idx)};
+    return {idx, versions[idx]};
+  }
+
+  void destroy_entity(Entity e) {
+    if (!is_alive(e))
+      return;
+
+    // increment version to invalidate old handles
+    versions[e.index]++;
+
+    Record &rec = records[e.index];
+    remove_row(*rec.arch, rec.row);
+    rec = {};
+    free_list.push_back(e.index);
+  }
+
+  bool is_alive(Entity e) const {
+    return e.index < versions.size() && versions[e.index] == e.version;
+  }
+
+  // -------------------------------------------
+  // Component registration & ids
+  // -------------------------------------------
+  // Get or assign a compact component id for type T
+  template <typename T> size_t component_id() {
+    const size_t family = ComponentFamily::id<T>();
+    if (family >= family_to_cid.size())
+      family_to_cid.resize(family + 1, NO_COMPONENT);
+    if (family_to_cid[family] == NO_COMPONENT) {
+      family_to_cid[family] = infos.size();
+      infos.push_back(ComponentInfo::of<T>());
+    }
+    return family_to_cid[family];
+  }
+
+  // -------------------------------------------
+  // Basic component API (add/get/has/remove)
+  // -------------------------------------------
+  template <typename T, typename... Args> T &add(Entity e, Args &&...args) {
+    assert(is_alive(e));
+    const size_t cid = component_id<T>();
+    Record &rec = records[e.index];
+
+    if (rec.arch->has(cid)) {
+      // Overwrite existing component
+      T &comp = *static_cast<T *>(rec.arch->at(cid, rec.row));
+      comp = make<T>(std::forward<Args>(args)...);
+      return comp;
+    }
+
+    // build the value before the move: args may alias the entity's own
+    // components, and a throwing constructor must leave the row untouched
+    T value = make<T>(std::forward<Args>(args)...);
+    Archetype *target = archetype_with(rec.arch, cid);
+    move_entity(e.index, *target);
+    return *new (target->at(cid, rec.row)) T(std::move(value));
+  }
+
+  template <typename T> bool has(Entity e) const {
+    if (!is_alive(e))
+      return false;
+    const size_t cid = find_component_id<T>();
+    return cid != NO_COMPONENT && records[e.index].arch->has(cid);
+  }
+
+  template <typename T> T &get(Entity e) {
+    assert(has<T>(e));
+    const Record &rec = records[e.index];
+    return *static_cast<T *>(rec.arch->at(find_component_id<T>(), rec.row));
+  }
+
+  template <typename T> void remove(Entity e) {
+    if (!is_alive(e))
+      return;
+    const size_t cid = find_component_id<T>();
+    Record &rec = records[e.index];
+    if (cid == NO_COMPONENT || !rec.arch->has(cid))
+      return;
+    move_entity(e.index, *archetype_without(rec.arch, cid));
+  }
+
+  // -------------------------------------------
+  // Views
+  // -------------------------------------------
+  // Iterate every entity that has all of T1, Ts... and call
+  // fn(Entity, T1&, Ts&...), archetype by archetype and chunk by chunk.
+  template <typename T1, typename... Ts, typename Func> void view(Func &&fn) {
+    constexpr size_t N = 1 + sizeof...(Ts);
+    const std::array<size_t, N> cids = {find_component_id<T1>(),
+                                        find_component_id<Ts>()...};
+    CompactMask<N> req;
+    for (size_t cid : cids) {
+      if (cid == NO_COMPONENT)
+        return;
+      req.add(cid);
+    }
+
+    for (auto &arch : archetypes) {
+      if (arch->count == 0 ||
+          !req.test(arch->mask.data(), arch->mask.size()))
+        continue;
+      view_archetype<T1, Ts...>(*arch, cids, fn,
+                                std::make_index_sequence<N>{});
+    }
+  }
+
+  // Number of archetypes created so far (including the empty root).
+  size_t archetype_count() const { return archetypes.size(); }
+
+private:
+  static constexpr size_t NO_COMPONENT = ~size_t(0);
+
+  // T(args...) if T has that constructor, else T{args...}
+  template <typename T, typename... Args> static T make(Args &&...args) {
+    if constexpr (std::is_constructible_v<T, Args &&...>)
+      return T(std::forward<Args>(args)...);
+    else
+      return T{std::forward<Args>(args)...};
+  }
+
+  // -------------------------------------------
+  // Type-erased component operations
+  // -------------------------------------------
+  struct ComponentInfo {
+    size_t size;
+    size_t align;
+    void (*move_construct)(void *dst, void *src);
+    void (*destroy)(void *ptr);
+
+    template <typename T> static ComponentInfo of() {
+      return {sizeof(T), alignof(T),
+              [](void *dst, void *src) {
+                new (dst) T(std::move(*static_cast<T *>(src)));
+              },
+              [](void *ptr) { static_cast<T *>(ptr)->~T(); }};
+    }
+  };
+
+  // -------------------------------------------
+  // Archetype: one table of rows sharing a component mask
+  // -------------------------------------------
+  struct ChunkDeleter {
+    void operator()(std::byte *p) const {
+      ::operator delete(p, std::align_val_t(64));
+    }
+  };
+  using ChunkPtr = std::unique_ptr<std::byte, ChunkDeleter>;
+
+  struct Archetype {
+    std::vector<uint64_t> mask;     // trailing zero blocks trimmed
+    std::vector<size_t> comp_ids;   // ascending component ids
+    std::vector<size_t> column_of;  // comp id -> column (NO_COMPONENT)
+    std::vector<size_t> col_offset; // byte offset of each column in a chunk
+    std::vector<ComponentInfo> col_info;
+    size_t chunk_shift = 0; // rows per chunk = 1 << chunk_shift
+    size_t chunk_bytes = 0;
+    std::vector<ChunkPtr> chunks;
+    size_t count = 0;
+
+    // cached graph edges, indexed by comp id (nullptr = not computed yet)
+    std::vector<Archetype *> add_edges;
+    std::vector<Archetype *> remove_edges;
+
+    ~Archetype() {
+      for (size_t row = 0; row < count; ++row)
+        for (size_t col = 0; col < col_info.size(); ++col)
+          col_info[col].destroy(at_column(col, row));
+    }
+
+    size_t capacity() const { return size_t(1) << chunk_shift; }
+
+    bool has(size_t cid) const {
+      return cid < column_of.size() && column_of[cid] != NO_COMPONENT;
+    }
+
+    std::byte *chunk_of(size_t row) const {
+      return chunks[row >> chunk_shift].get();
+    }
+
+    uint32_t *entities_in(size_t chunk) const {
+      return reinterpret_cast<uint32_t *>(chunks[chunk].get());
+    }
+
+    void *at_column(size_t col, size_t row) const {
+      const size_t slot = row & (capacity() - 1);
+      return chunk_of(row) + col_offset[col] + slot * col_info[col].size;
+    }
+
+    void *at(size_t cid, size_t row) const {
+      return at_column(column_of[cid], row);
+    }
+
+    uint32_t &entity_at(size_t row) const {
+      return entities_in(row >> chunk_shift)[row & (capacity() - 1)];
+    }
+
+    // Append a row for ent (components left unconstructed); returns it.
+    size_t push_row(uint32_t ent) {
+      if (count == chunks.size() * capacity())
+        chunks.emplace_back(static_cast<std::byte *>(
+            ::operator new(chunk_bytes, std::align_val_t(64))));
+      entity_at(count) = ent;
+      return count++;
+    }
+  };
+
+  // per-entity location
+  struct Record {
+    Archetype *arch = nullptr;
+    size_t row = 0;
+  };
+
+  std::vector<std::unique_ptr<Archetype>> archetypes;
+  std::map<std::vector<uint64_t>, Archetype *> archetype_by_mask;
+  Archetype *root = nullptr;
+
+  std::vector<ComponentInfo> infos;  // by comp id
+  std::vector<size_t> family_to_cid; // family id -> comp id
+
+  // per-entity versioning, location & free list
+  std::vector<uint32_t> versions;
+  std::vector<Record> records;
+  std::vector<uint32_t> free_list;
+
+  // -------------------------------------------
+  // Helpers
+  // -------------------------------------------
+  template <typename T> size_t find_component_id() const {
+    const size_t family = ComponentFamily::id<T>();
+    return family < family_to_cid.size() ? family_to_cid[family]
+                                         : NO_COMPONENT;
+  }
+
+  Archetype *get_or_create_archetype(std::vector<uint64_t> mask) {
+    while (!mask.empty() && mask.back() == 0)
+      mask.pop_back();
+    auto it = archetype_by_mask.find(mask);
+    if (it != archetype_by_mask.end())
+      return it->second;
+
+    auto arch = std::make_unique<Archetype>();
+    arch->mask = mask;
+    for (size_t cid = 0; cid < mask.size() * BitMaskHelper::BLOCK_BITS; ++cid)
+      if (BitMaskHelper::test_bit(mask.data(), cid))
+        arch->comp_ids.push_back(cid);
+
+    size_t max_cid = arch->comp_ids.empty() ? 0 : arch->comp_ids.back() + 1;
+    arch->column_of.assign(max_cid, NO_COMPONENT);
+    size_t row_bytes = sizeof(uint32_t);
+    for (size_t col = 0; col < arch->comp_ids.size(); ++col) {
+      arch->column_of[arch->comp_ids[col]] = col;
+      arch->col_info.push_back(infos[arch->comp_ids[col]]);
+      row_bytes += infos[arch->comp_ids[col]].size;
+    }
+
+    // largest power-of-two row count whose layout fits in CHUNK_BYTES
+    size_t shift = 0;
+    while ((row_bytes << (shift + 1)) <= CHUNK_BYTES)
+      ++shift;
+    while (true) {
+      size_t cap = size_t(1) << shift;
+      size_t bytes = sizeof(uint32_t) * cap;
+      arch->col_offset.clear();
+      for (const ComponentInfo &info : arch->col_info) {
+        size_t a = std::max<size_t>(info.align, 16);
+        bytes = (bytes + a - 1) / a * a;
+        arch->col_offset.push_back(bytes);
+        bytes += info.size * cap;
+      }
+      if (bytes <= CHUNK_BYTES || shift == 0) {
+        arch->chunk_shift = shift;
+        arch->chunk_bytes = bytes;
+        break;
+      }
+      --shift;
+    }
+
+    Archetype *ptr = arch.get();
+    archetypes.push_back(std::move(arch));
+    archetype_by_mask.emplace(std::move(mask), ptr);
+    return ptr;
+  }
+
+  // Archetype reached from `from` by adding cid (cached edge)
+  Archetype *archetype_with(Archetype *from, size_t cid) {
+    if (cid < from->add_edges.size() && from->add_edges[cid])
+      return from->add_edges[cid];
+
+    std::vector<uint64_t> mask = from->mask;
+    mask.resize(std::max(mask.size(), BitMaskHelper::blocks_for_bits(cid + 1)),
+                0ull);
+    BitMaskHelper::set_bit(mask.data(), cid);
+    Archetype *to = get_or_create_archetype(std::move(mask));
+    link(from, to, cid);
+    return to;
+  }
+
+  // Archetype reached from `from` by removing cid (cached edge)
+  Archetype *archetype_without(Archetype *from, size_t cid) {
+    if (cid < from->remove_edges.size() && from->remove_edges[cid])
+      return from->remove_edges[cid];
+
+    std::vector<uint64_t> mask = from->mask;
+    BitMaskHelper::reset_bit(mask.data(), cid);
+    Archetype *to = get_or_create_archetype(std::move(mask));
+    link(to, from, cid);
+    return to;
+  }
+
+  // Record that `with` == `without` + cid in both directions
+  static void link(Archetype *without, Archetype *with, size_t cid) {
+    if (cid >= without->add_edges.size())
+      without->add_edges.resize(cid + 1, nullptr);
+    if (cid >= with->remove_edges.size())
+      with->remove_edges.resize(cid + 1, nullptr);
+    without->add_edges[cid] = with;
+    with->remove_edges[cid] = without;
+  }
+
+  // Move ent's row into `to`, carrying every component both archetypes
+  // share. Components only in `to` are left for the caller to construct.
+  void move_entity(uint32_t ent, Archetype &to) {
+    Record &rec = records[ent];
+    Archetype &from = *rec.arch;
+    const size_t new_row = to.push_row(ent);
+    for (size_t col = 0; col < to.comp_ids.size(); ++col) {
+      const size_t cid = to.comp_ids[col];
+      if (from.has(cid))
+        to.col_info[col].move_construct(to.at_column(col, new_row),
+                                        from.at(cid, rec.row));
+    }
+    remove_row(from, rec.row);
+    rec = {&to, new_row};
+  }
+
+  // Destroy the row's components and fill the hole with the last row.
+  void remove_row(Archetype &arch, size_t row) {
+    const size_t last = arch.count - 1;
+    for (size_t col = 0; col < arch.comp_ids.size(); ++col) {
+      const ComponentInfo &info = arch.col_info[col];
+      info.destroy(arch.at_column(col, row));
+      if (row != last) {
+        info.move_construct(arch.at_column(col, row),
+                            arch.at_column(col, last));
+        info.destroy(arch.at_column(col, last));
+      }
+    }
+    if (row != last) {
+      const uint32_t moved = arch.entity_at(last);
+      arch.entity_at(row) = moved;
+      records[moved].row = row;
+    }
+    --arch.count;
+  }
+
+  template <typename... Ts, size_t N, typename Func, size_t... Is>
+  void view_archetype(Archetype &arch, const std::array<size_t, N> &cids,
+                      Func &fn, std::index_sequence<Is...>) {
+    const size_t cap = arch.capacity();
+    const std::array<size_t, N> offsets = {
+        arch.col_offset[arch.column_of[cids[Is]]]...};
+    for (size_t c = 0; c * cap < arch.count; ++c) {
+      std::byte *chunk = arch.chunks[c].get();
+      const uint32_t *ents = arch.entities_in(c);
+      const size_t rows = std::min(cap, arch.count - c * cap);
+      auto cols =
+          std::make_tuple(reinterpret_cast<Ts *>(chunk + offsets[Is])...);
+      for (size_t r = 0; r < rows; ++r)
+        fn(Entity{ents[r], versions[ents[r]]}, std::get<Is>(cols)[r]...);
+    }
+  }
+};
@@ -0,0 +1,405 @@
+#pragma once
+#include "ecs.h"
+#include "job_system.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//
+// Deferred command buffer
+//
+// Design notes:
+// - Structural changes (create/destroy entities, add/remove components)
+//   are recorded instead of executed, so they can be issued from inside a
+//   view without swap-removing elements out from under the iteration.
+// - Records live back to back in a chunked byte arena: a small fixed
+//   header followed by the component value, constructed in place. Nothing
+//   is allocated per command once the chunks have grown to their working
+//   size; clear() keeps them for the next frame.
+// - create() hands out a deferred handle with version 0 (never a live
+//   version) whose index numbers the buffer's pending creates. It can be
+//   used as the target of later commands in the same buffer.
+// - apply() runs at a sync point, in three passes: creates first, then
+//   add/remove sorted by component type (stable, so commands on one type
+//   keep their recorded order and each storage is touched in one run),
+//   then destroys.
+// - merge() splices another buffer's chunks onto this one and shifts its
+//   deferred handles; nothing is copied. Together with one buffer per
+//   job-system thread (CommandBuffers) this lets parallel views record
+//   without any locking. CommandBuffers hands the spliced chunks back
+//   after apply(), so every thread keeps its own working set.
+// - BasicCommandBuffer<MaxComponents> plays back into a
+//   BasicECS<MaxComponents>; CommandBuffer is the one for ECS.
+//
+template <size_t MaxComponents> class BasicCommandBuffer {
+  using World = BasicECS<MaxComponents>;
+
+public:
+  // Version carried by handles from create() until the buffer is applied.
+  static constexpr uint32_t DEFERRED_VERSION = 0;
+
+  BasicCommandBuffer() = default;
+  ~BasicCommandBuffer() { clear(); }
+
+  BasicCommandBuffer(BasicCommandBuffer &&other) noexcept {
+    *this = std::move(other);
+  }
+  BasicCommandBuffer &operator=(BasicCommandBuffer &&other) noexcept {
+    if (this != &other) {
+      clear();
+      chunks = std::move(other.chunks);
+      current = std::exchange(other.current, 0);
+      commands = std::exchange(other.commands, 0);
+      created = std::exchange(other.created, 0);
+    }
+    return *this;
+  }
+  BasicCommandBuffer(const BasicCommandBuffer &) = delete;
+  BasicCommandBuffer &operator=(const BasicCommandBuffer &) = delete;
+
+  // -------------------------------------------
+  // Recording
+  // -------------------------------------------
+  // Reserve an entity that is created by apply().
+  Entity create() { return Entity{created++, DEFERRED_VERSION}; }
+
+  void destroy(Entity e) { push_record(DESTROY, nullptr, e, 0, 1); }
+
+  // Record add<T>(e, args...); the value is built in the arena now, as
+  // ECS::add would build it: T(args...), or T{args...} for aggregates.
+  template <typename T, typename... Args> void add(Entity e, Args &&...args) {
+    static_assert(alignof(T) <= CHUNK_ALIGN, "over-aligned component");
+    void *payload = push_record(ADD, &ops_for<T>(), e, sizeof(T), alignof(T));
+    if constexpr (std::is_constructible_v<T, Args &&...>)
+      new (payload) T(std::forward<Args>(args)...);
+    else
+      new (payload) T{std::forward<Args>(args)...};
+  }
+
+  template <typename T> void remove(Entity e) {
+    push_record(REMOVE, &ops_for<T>(), e, 0, 1);
+  }
+
+  // Move every command of `other` behind the ones recorded here. Deferred
+  // handles of `other` are renumbered after this buffer's own. Returns the
+  // number of chunks taken; `other` keeps its empty ones.
+  size_t merge(BasicCommandBuffer &other) {
+    if (&other == this || other.commands + other.created == 0)
+      return 0;
+    size_t taken = 0, kept = 0;
+    for (auto &chunk : other.chunks) {
+      if (chunk.used == 0) {
+        if (&other.chunks[kept] != &chunk)
+          other.chunks[kept] = std::move(chunk);
+        ++kept;
+        continue;
+      }
+      chunk.entity_base += created;
+      chunks.push_back(std::move(chunk));
+      ++taken;
+    }
+    other.chunks.erase(other.chunks.begin() + kept, other.chunks.end());
+    // keep appending after the spliced chunks
+    current = chunks.size();
+    commands += other.commands;
+    created += other.created;
+    other.current = 0;
+    other.commands = 0;
+    other.created = 0;
+    return taken;
+  }
+
+  // Move the last n chunks (those a merge() took) back to `other`. Both
+  // buffers must be empty, i.e. applied or cleared.
+  void give_back(BasicCommandBuffer &other, size_t n) {
+    assert(empty() && other.empty() && n <= chunks.size());
+    for (size_t i = chunks.size() - n; i < chunks.size(); ++i)
+      other.chunks.push_back(std::move(chunks[i]));
+    chunks.erase(chunks.end() - n, chunks.end());
+  }
+
+  // -------------------------------------------
+  // Playback
+  // -------------------------------------------
+  // Execute all recorded commands against `ecs` and clear the buffer.
+  // Commands on entities that are dead by then are skipped.
+  void apply(World &ecs) {
+    spawned.resize(created);
+    for (auto &e : spawned)
+      e = ecs.create_entity();
+
+    // counting sort by family id: ids are small and dense, and buckets
+    // keep the recorded order within a type
+    family_counts.clear();
+    destroys.clear();
+    size_t structural = 0;
+    for_each_record([&](Record *rec, uint32_t) {
+      if (rec->kind == DESTROY)
+        return;
+      size_t family = rec->ops->family;
+      if (family >= family_counts.size())
+        family_counts.resize(family + 1, 0);
+      family_counts[family]++;
+      structural++;
+    });
+    size_t offset = 0;
+    for (auto &count : family_counts)
+      offset += std::exchange(count, offset);
+
+    pending.resize(structural);
+    for_each_record([&](Record *rec, uint32_t entity_base) {
+      if (rec->kind == DESTROY)
+        destroys.push_back(resolve(rec->target, entity_base));
+      else
+        pending[family_counts[rec->ops->family]++] = {rec, entity_base};
+    });
+
+    for (const Pending &p : pending) {
+      Entity e = resolve(p.rec->target, p.entity_base);
+      if (p.rec->kind == ADD)
+        p.rec->ops->add(ecs, e, payload_of(p.rec));
+      else
+        p.rec->ops->remove(ecs, e);
+    }
+
+    for (Entity e : destroys)
+      ecs.destroy_entity(e);
+
+    // payloads were moved out and destroyed by ops->add
+    reset();
+  }
+
+  // Drop every recorded command without applying it.
+  void clear() {
+    for_each_record([](Record *rec, uint32_t) {
+      if (rec->kind == ADD)
+        rec->ops->drop(payload_of(rec));
+    });
+    reset();
+  }
+
+  bool empty() const { return commands == 0 && created == 0; }
+
+  // number of recorded destroy/add/remove commands
+  size_t size() const { return commands; }
+
+  // number of entities reserved with create()
+  size_t pending_creates() const { return created; }
+
+  // arena bytes in use by the recorded commands
+  size_t bytes() const {
+    size_t total = 0;
+    for (auto &chunk : chunks)
+      total += chunk.used;
+    return total;
+  }
+
+  // arena bytes allocated, used or not
+  size_t capacity() const {
+    size_t total = 0;
+    for (auto &chunk : chunks)
+      total += chunk.capacity;
+    return total;
+  }
+
+private:
+  static constexpr size_t CHUNK_BYTES = 16 * 1024;
+  static constexpr size_t CHUNK_ALIGN = 64;
+
+  enum Kind : uint32_t { ADD, REMOVE, DESTROY };
+
+  // Type-erased operations of one component type.
+  struct Ops {
+    size_t family;
+    void (*add)(World &, Entity, void *payload); // consumes the payload
+    void (*remove)(World &, Entity);
+    void (*drop)(void *payload);
+  };
+
+  template <typename T> static const Ops &ops_for() {
+    static const Ops ops = {
+        ComponentFamily::id<T>(),
+        [](World &ecs, Entity e, void *payload) {
+          T *value = static_cast<T *>(payload);
+          if (ecs.is_alive(e))
+            ecs.template add<T>(e, std::move(*value));
+          value->~T();
+        },
+        [](World &ecs, Entity e) { ecs.template remove<T>(e); },
+        [](void *payload) { static_cast<T *>(payload)->~T(); }};
+    return ops;
+  }
+
+  // Header in front of every record. The payload (ADD only) starts
+  // `payload` bytes after the header; `size` covers header, padding and
+  // payload and keeps the next header aligned.
+  struct Record {
+    const Ops *ops;
+    Entity target;
+    uint32_t kind;
+    uint32_t size;
+    uint32_t payload;
+  };
+
+  struct AlignedDelete {
+    void operator()(unsigned char *p) const {
+      ::operator delete(p, std::align_val_t(CHUNK_ALIGN));
+    }
+  };
+
+  struct Chunk {
+    explicit Chunk(size_t capacity)
+        : data(static_cast<unsigned char *>(
+              ::operator new(capacity, std::align_val_t(CHUNK_ALIGN)))),
+          capacity(capacity) {}
+    std::unique_ptr<unsigned char, AlignedDelete> data;
+    size_t capacity;
+    size_t used = 0;
+    // added to the index of deferred handles recorded in this chunk
+    uint32_t entity_base = 0;
+  };
+
+  struct Pending {
+    Record *rec;
+    uint32_t entity_base;
+  };
+
+  static size_t align_up(size_t n, size_t a) { return (n + a - 1) & ~(a - 1); }
+
+  static void *payload_of(Record *rec) {
+    return reinterpret_cast<unsigned char *>(rec) + rec->payload;
+  }
+
+  // Visit the records in recorded order as fn(record, entity_base).
+  template <typename Func> void for_each_record(Func &&fn) {
+    for (auto &chunk : chunks)
+      for (size_t at = 0; at < chunk.used;) {
+        Record *rec = reinterpret_cast<Record *>(chunk.data.get() + at);
+        fn(rec, chunk.entity_base);
+        at += rec->size;
+      }
+  }
+
+  Entity resolve(Entity e, uint32_t entity_base) const {
+    if (e.version != DEFERRED_VERSION)
+      return e;
+    return spawned[e.index + entity_base];
+  }
+
+  // Append a record header (+ room for the payload) and return the
+  // payload address.
+  void *push_record(Kind kind, const Ops *ops, Entity target,
+                    size_t payload_size, size_t payload_align) {
+    // chunks start CHUNK_ALIGN-aligned, so aligning the payload's offset
+    // in its chunk aligns its address
+    size_t payload_off = 0, size = 0;
+    auto fit = [&](size_t used) {
+      payload_off = align_up(used + sizeof(Record), payload_align) - used;
+      size = align_up(payload_off + payload_size, alignof(Record));
+    };
+
+    for (; current < chunks.size(); ++current) {
+      fit(chunks[current].used);
+      if (chunks[current].capacity - chunks[current].used >= size)
+        break;
+    }
+    if (current == chunks.size()) {
+      fit(0);
+      chunks.emplace_back(std::max(CHUNK_BYTES, size));
+    }
+
+    Chunk &chunk = chunks[current];
+    unsigned char *at = chunk.data.get() + chunk.used;
+    chunk.used += size;
+    ++commands;
+
+    Record *rec = new (at) Record{ops, target, kind, uint32_t(size),
+                                  uint32_t(payload_off)};
+    return payload_of(rec);
+  }
+
+  // Forget all records (payloads must already be gone); keep the chunks.
+  void reset() {
+    for (auto &chunk : chunks) {
+      chunk.used = 0;
+      chunk.entity_base = 0;
+    }
+    current = 0;
+    commands = 0;
+    created = 0;
+  }
+
+  std::vector<Chunk> chunks;
+  size_t current = 0; // chunk that receives the next record
+  size_t commands = 0;
+  uint32_t created = 0;
+
+  // scratch space reused by apply()
+  std::vector<Entity> spawned;
+  std::vector<Pending> pending;
+  std::vector<Entity> destroys;
+  std::vector<size_t> family_counts;
+};
+
+using CommandBuffer = BasicCommandBuffer<0>;
+
+// -------------------------------------------------------------
+// Per-thread command buffers
+// -------------------------------------------------------------
+// One CommandBuffer per JobSystem thread (plus one shared by outside
+// threads). Jobs record into local() without locking; apply() merges them
+// in thread order at the sync point, plays them back and returns the
+// chunks to the buffers they came from. Deferred handles are only valid
+// within the buffer that created them. Outside threads all get the same
+// buffer, so at most one of them may record at a time.
+template <size_t MaxComponents> class BasicCommandBuffers {
+public:
+  explicit BasicCommandBuffers(JobSystem &jobs = JobSystem::global())
+      : jobs(jobs), slots(jobs.thread_count() + 1) {}
+
+  BasicCommandBuffer<MaxComponents> &local() {
+    return slots[jobs.thread_index()].buffer;
+  }
+
+  void apply(BasicECS<MaxComponents> &ecs) {
+    BasicCommandBuffer<MaxComponents> &first = slots[0].buffer;
+    taken.resize(slots.size());
+    for (size_t i = 1; i < slots.size(); ++i)
+      taken[i] = first.merge(slots[i].buffer);
+    first.apply(ecs);
+    // the spliced chunks sit at the back of `first`, in slot order
+    for (size_t i = slots.size() - 1; i > 0; --i)
+      first.give_back(slots[i].buffer, taken[i]);
+  }
+
+  void clear() {
+    for (auto &slot : slots)
+      slot.buffer.clear();
+  }
+
+  // arena bytes allocated across all buffers
+  size_t capacity() const {
+    size_t total = 0;
+    for (auto &slot : slots)
+      total += slot.buffer.capacity();
+    return total;
+  }
+
+private:
+  // one cache line per buffer so recording threads don't false-share
+  struct alignas(64) Slot {
+    BasicCommandBuffer<MaxComponents> buffer;
+  };
+
+  JobSystem &jobs;
+  std::vector<Slot> slots;
+  std::vector<size_t> taken; // chunks merged from each slot by apply()
+};
+
+using CommandBuffers = BasicCommandBuffers<0>;
@@ -1,25 +1,58 @@
 #pragma once
 #include "sparse_set.h" // your SparseSet<T> implementation
+#include "job_system.h"
+#include "mask_filter.h"
+#include "signal.h"
+#include "span.h"
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
 #include <cstdint>
 #include <functional>
 #include <memory>
 #include <tuple>
-#include <typeindex>
-#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 //
 // ECS with component-type IDs + per-entity bitmasks + groups
 //
 // Design notes:
-// - Each component type gets a compact component-id (size_t).
+// - Each component type gets a process-wide family id (ComponentFamily) that
+//   indexes a flat storage table, so lookups never hash a type.
+// - Each component type gets a compact per-world component-id (size_t) used
+//   as its bit position in the entity masks.
 // - Masks are stored as flat blocks of uint64_t per entity (maskBlocks).
 // - When component types are added, masks/g roups are resized to accommodate.
 // - view<Ts...> iterates the smallest component storage for best perf and
 //   uses a mask check (bitwise) to skip non-matching entities quickly.
+//   Candidates are tested a block at a time with a vectorized filter that
+//   emits the matching positions (mask_filter.h).
 // - Groups are simply precomputed masks for a set of components.
+// - Owning groups additionally keep the entities that have all of their
+//   components packed at the front of those storages, in the same order.
+// - Tag components (empty types) store no values, only their entity list
+//   (TagSet); views and groups still filter on them but leave them out of
+//   the callback's parameters.
+// - Change detection is opt-in per storage: once a view filters on
+//   Added<T>/Changed<T>/Removed<T>, T's storage keeps a tick per entry for
+//   insertion and for the last mutable access, plus a log of removals.
+// - Non-owning groups keep their own dense list of matching entities,
+//   updated as components come and go, without reordering any storage.
+// - ComponentTraits<T> (sparse_set.h) can give a type paged storage with
+//   stable addresses; with in_place_delete its dense range has holes
+//   (TOMBSTONE entries) that views skip and owning groups can't work with.
+// - Storages carry on_construct / on_update / on_destroy signals
+//   (signal.h), allocated when first asked for.
+// - All sparse tables of a world (storages and non-owning group lists)
+//   share one SparsePagePool: a page emptied in one storage is reused by
+//   the next one that grows. memory_stats() / shrink_to_fit() report and
+//   release what the storages hold.
 //
 
 // -------------------------------------------------------------
@@ -45,7 +78,7 @@ public:
   static constexpr size_t BLOCK_BITS = 64;
 
   // helpers
-  static size_t blocks_for_bits(size_t bits) {
+  static constexpr size_t blocks_for_bits(size_t bits) {
     return (bits + BLOCK_BITS - 1) / BLOCK_BITS;
   }
 
@@ -62,6 +95,26 @@ public:
     return (mask[bit / BLOCK_BITS] >> (bit % BLOCK_BITS)) & 1u;
   }
 
+  // index of the lowest set bit; block must be non-zero
+  static inline size_t lowest_bit(uint64_t block) {
+#if defined(_MSC_VER)
+    unsigned long idx;
+    _BitScanForward64(&idx, block);
+    return idx;
+#else
+    return static_cast<size_t>(__builtin_ctzll(block));
+#endif
+  }
+
+  // call fn(bit) for every set bit of a mask of `blocks` blocks
+  template <typename Func>
+  static inline void for_each_bit(const uint64_t *mask, size_t blocks,
+                                  Func &&fn) {
+    for (size_t b = 0; b < blocks; ++b)
+      for (uint64_t bits = mask[b]; bits; bits &= bits - 1)
+        fn(b * BLOCK_BITS + lowest_bit(bits));
+  }
+
   // returns true if (entity_mask & required_mask) == required_mask
   // both masks must have same number of blocks
   static inline bool test_mask_match(const uint64_t *entity_mask,
@@ -74,14 +127,207 @@ public:
     }
     return true;
   }
+
+  // same test with the block count fixed at compile time (fully unrolled)
+  template <size_t Blocks>
+  static inline bool test_mask_match(const uint64_t *entity_mask,
+                                     const uint64_t *required_mask) {
+    return test_mask_match_unrolled(entity_mask, required_mask,
+                                    std::make_index_sequence<Blocks>{});
+  }
+
+private:
+  template <size_t... Is>
+  static inline bool
+  test_mask_match_unrolled(const uint64_t *entity_mask,
+                           const uint64_t *required_mask,
+                           std::index_sequence<Is...>) {
+    return (((entity_mask[Is] & required_mask[Is]) == required_mask[Is]) &&
+            ...);
+  }
+};
+
+// -------------------------------------------------------------
+// Per-entity mask storage
+// -------------------------------------------------------------
+// DynamicMasks: flat uint64_t blocks per entity; the block count grows with
+// the number of registered component types, which re-lays out every mask.
+class DynamicMasks {
+public:
+  size_t width() const { return blocks; }
+
+  uint64_t *row(size_t ent) { return blocks ? &data[ent * blocks] : nullptr; }
+  const uint64_t *row(size_t ent) const {
+    return blocks ? &data[ent * blocks] : nullptr;
+  }
+
+  // make room for masks of `entities` entities
+  void reserve_entities(size_t entities) {
+    if (data.size() < entities * blocks)
+      data.resize(entities * blocks, 0ull);
+  }
+
+  // widen every mask so `components` bits fit
+  void grow_components(size_t components, size_t entities) {
+    size_t new_blocks = BitMaskHelper::blocks_for_bits(components);
+    if (new_blocks == blocks)
+      return;
+
+    // create new masks vector sized entities * new_blocks
+    std::vector<uint64_t> new_masks;
+    new_masks.assign(entities * new_blocks, 0ull);
+
+    // copy old masks into new layout
+    for (size_t ent = 0; ent < entities && blocks > 0; ++ent)
+      for (size_t b = 0; b < blocks; ++b)
+        new_masks[ent * new_blocks + b] = data[ent * blocks + b];
+
+    data.swap(new_masks);
+    blocks = new_blocks;
+  }
+
+private:
+  // flat storage: data[entity * blocks + block_index]
+  std::vector<uint64_t> data;
+  size_t blocks = 0;
+};
+
+// FixedMasks<Blocks>: one std::array per entity, width known at compile
+// time. Registering components never touches existing masks.
+template <size_t Blocks> class FixedMasks {
+public:
+  using Mask = std::array<uint64_t, Blocks>;
+
+  static constexpr size_t width() { return Blocks; }
+
+  uint64_t *row(size_t ent) { return data[ent].data(); }
+  const uint64_t *row(size_t ent) const { return data[ent].data(); }
+
+  void reserve_entities(size_t entities) {
+    if (data.size() < entities)
+      data.resize(entities, Mask{});
+  }
+
+  void grow_components(size_t components, size_t) {
+    assert(components <= Blocks * BitMaskHelper::BLOCK_BITS &&
+           "more component types than BasicECS<MaxComponents> allows");
+  }
+
+private:
+  std::vector<Mask> data;
+};
+
+// Mask test for a query over N component types, stored as at most N
+// (block, care, bits) terms so it never allocates. A mask matches when
+// (mask[block] & care) == bits for every term: required components are set
+// in both care and bits, excluded ones only in care, so exclusions cost
+// nothing beyond the required-mask check.
+template <size_t N> struct CompactMask {
+  std::array<size_t, N> blocks;
+  std::array<uint64_t, N> care;
+  std::array<uint64_t, N> bits;
+  size_t terms = 0;
+
+  // require comp_id
+  void add(size_t comp_id) { add_term(comp_id, true); }
+
+  // require comp_id to be absent
+  void exclude(size_t comp_id) { add_term(comp_id, false); }
+
+  // mask must cover every block referenced by the terms
+  inline bool test(const uint64_t *mask) const {
+    for (size_t i = 0; i < terms; ++i)
+      if ((mask[blocks[i]] & care[i]) != bits[i])
+        return false;
+    return true;
+  }
+
+  // mask of `blocks_in_mask` blocks; missing blocks count as zero
+  inline bool test(const uint64_t *mask, size_t blocks_in_mask) const {
+    for (size_t i = 0; i < terms; ++i) {
+      uint64_t m = blocks[i] < blocks_in_mask ? mask[blocks[i]] : 0;
+      if ((m & care[i]) != bits[i])
+        return false;
+    }
+    return true;
+  }
+
+private:
+  void add_term(size_t comp_id, bool required) {
+    size_t block = comp_id / BitMaskHelper::BLOCK_BITS;
+    uint64_t bit = uint64_t(1) << (comp_id % BitMaskHelper::BLOCK_BITS);
+    uint64_t want = required ? bit : 0;
+    for (size_t i = 0; i < terms; ++i)
+      if (blocks[i] == block) {
+        care[i] |= bit;
+        bits[i] |= want;
+        return;
+      }
+    blocks[terms] = block;
+    care[terms] = bit;
+    bits[terms] = want;
+    ++terms;
+  }
 };
 
+// -------------------------------------------------------------
+// Component type families
+// -------------------------------------------------------------
+// Every distinct component type is assigned a small integer the first time
+// ComponentFamily::id<T>() is instantiated and called. The value is fixed for
+// the lifetime of the process, so worlds can use it to index a flat table
+// instead of hashing std::type_index on every access.
+class ComponentFamily {
+public:
+  template <typename T> static size_t id() {
+    static const size_t value = next();
+    return value;
+  }
+
+private:
+  static size_t next() {
+    static std::atomic<size_t> counter{0};
+    return counter.fetch_add(1, std::memory_order_relaxed);
+  }
+};
+
+// -------------------------------------------------------------
+// View filters
+// -------------------------------------------------------------
+// Component types a view or query must not have:
+//   ecs.view<Position, Velocity>(exclude<Dead>, fn);
+// A pointer parameter (view<Position, Velocity *>) is optional: fn gets
+// nullptr for entities without it.
+template <typename... Ts> struct exclude_t {
+  static constexpr size_t size = sizeof...(Ts);
+};
+template <typename... Ts> inline constexpr exclude_t<Ts...> exclude{};
+
+// Change filters. They select entities but pass no argument to fn:
+//   Added<T>   - has T, inserted since the view last ran
+//   Changed<T> - has T, inserted or mutably accessed since then
+//   Removed<T> - alive, lacks T, and lost it since then
+// "Since the view last ran" is since the previous each() for a persistent
+// query and since ECS::advance_frame() for a one-shot view. A const T
+// parameter reads without counting as a change.
+template <typename T> struct Added {};
+template <typename T> struct Changed {};
+template <typename T> struct Removed {};
+
 // -------------------------------------------------------------
 // ECS class (component id bookkeeping + per-entity masks)
 // -------------------------------------------------------------
-class ECS {
+// MaxComponents == 0: masks grow with the number of registered types.
+// MaxComponents > 0: masks are std::array<uint64_t, N> sized for at most
+// MaxComponents types, so mask tests unroll and registration never
+// reallocates them.
+template <size_t MaxComponents> class BasicECS {
+  using Masks = std::conditional_t<
+      MaxComponents == 0, DynamicMasks,
+      FixedMasks<BitMaskHelper::blocks_for_bits(MaxComponents)>>;
+
 public:
-  ECS() : component_count(0), mask_blocks(0) {}
+  BasicECS() : component_count(0) {}
 
   // -------------------------------------------
   // Entity management
@@ -102,27 +348,87 @@ public:
     return {idx, 1};
   }
 
+  // Create n entities and write their handles to out[0..n). Recycled
+  // indices are used first; the rest grow versions and masks in one step.
+  void create_entities(size_t n, Entity *out) {
+    size_t reused = std::min(n, free_list.size());
+    for (size_t i = 0; i < reused; ++i) {
+      uint32_t idx = free_list.back();
+      free_list.pop_back();
+      out[i] = {idx, versions[idx]};
+    }
+
+    const uint32_t first = static_cast<uint32_t>(versions.size());
+    const size_t fresh = n - reused;
+    versions.resize(versions.size() + fresh, 1);
+    ensure_entity_mask_size(versions.size());
+    for (size_t i = 0; i < fresh; ++i)
+      out[reused + i] = {first + static_cast<uint32_t>(i), 1};
+  }
+
   void destroy_entity(Entity e) {
     if (!is_alive(e))
       return;
 
+    // the mask lists exactly the storages holding e: erase from those only
+    for_each_mask_bit(e.index, [&](size_t cid) {
+      IStorageBase &store = *component_storages[cid];
+      if (store.signals)
+        store.signals->on_destroy.publish(*this, e);
+      leave_groups(store, e.index);
+      store.erase_entity(e.index);
+    });
+    clear_mask(e.index);
+
     // increment version to invalidate old handles
     versions[e.index]++;
+    free_list.push_back(e.index);
+  }
 
-    // remove entity from all component storages and clear mask bits
-    for (auto &kv : component_storages) {
-      kv.second->erase_entity(e.index);
+  // Destroy many entities. Erasures are bucketed per storage so each
+  // storage (and its groups) is processed in one run. Dead or repeated
+  // handles are skipped. Indices are recycled (and versions bumped) only
+  // after the erasures, so entities that on_destroy listeners create
+  // cannot take an index whose components are still queued for erasure.
+  void destroy_entities(Span<const Entity> ents) {
+    scratch_doomed.clear();
+    scratch_marks.resize(versions.size(), 0);
+    for (Entity e : ents) {
+      // still alive until the end: repeats are caught by their mark
+      if (!is_alive(e) || scratch_marks[e.index])
+        continue;
+      // a listener may have registered a type since the last entity
+      if (scratch_buckets.size() < component_count)
+        scratch_buckets.resize(component_count);
+      for_each_mask_bit(e.index, [&](size_t cid) {
+        IStorageBase &store = *component_storages[cid];
+        if (store.signals)
+          store.signals->on_destroy.publish(*this, e);
+        scratch_buckets[cid].push_back(e.index);
+      });
+      clear_mask(e.index);
+      scratch_marks[e.index] = 1;
+      scratch_doomed.push_back(e.index);
     }
 
-    // clear mask blocks for this entity
-    if (mask_blocks > 0) {
-      uint64_t *mask_ptr =
-          &entity_masks[static_cast<size_t>(e.index) * mask_blocks];
-      for (size_t i = 0; i < mask_blocks; ++i)
-        mask_ptr[i] = 0;
+    for (size_t cid = 0; cid < scratch_buckets.size(); ++cid) {
+      std::vector<uint32_t> &bucket = scratch_buckets[cid];
+      if (bucket.empty())
+        continue;
+      IStorageBase &store = *component_storages[cid];
+      for (uint32_t ent : bucket) {
+        leave_groups(store, ent);
+        store.erase_entity(ent);
+      }
+      bucket.clear();
     }
 
-    free_list.push_back(e.index);
+    for (uint32_t idx : scratch_doomed) {
+      scratch_marks[idx] = 0;
+      versions[idx]++;
+      free_list.push_back(idx);
+    }
+    scratch_doomed.clear();
   }
 
   bool is_alive(Entity e) const {
@@ -134,58 +440,269 @@ public:
   // -------------------------------------------
   // Get or assign a compact component id for type T
   template <typename T> size_t component_id() {
-    auto it = type_to_id.find(std::type_index(typeid(T)));
-    if (it != type_to_id.end())
-      return it->second;
-
-    size_t id = component_count++;
-    type_to_id.emplace(std::type_index(typeid(T)), id);
-
-    // ensure all per-entity masks and existing groups expand to hold new id
-    expand_masks_for_new_component();
-
-    return id;
+    return get_or_create_storage<T>()->comp_id;
   }
 
   // -------------------------------------------
   // Basic component API (add/get/has/remove)
   // -------------------------------------------
+  // Give e a T built from args (T(args...), or T{args...} for aggregates)
+  // directly in T's storage; an existing T is overwritten. Publishes
+  // on_construct, or on_update if e already had T.
   template <typename T, typename... Args> T &add(Entity e, Args &&...args) {
     assert(is_alive(e));
     auto *store = get_or_create_storage<T>();
     size_t cid = store->comp_id;
-    // insert component into storage
-    T &comp = store->set.insert(e.index, T{std::forward<Args>(args)...});
+    auto *signals = store->signals.get();
+    const bool fresh = signals && !store->set.contains(e.index);
+    // construct the component in the storage
+    T &comp = store->emplace(e.index, tick(), std::forward<Args>(args)...);
     // set the bit in entity mask
     set_entity_bit(e.index, cid);
+    if (store->owner || !store->observers.empty())
+      join_groups(*store, e);
+    if (signals)
+      (fresh ? signals->on_construct : signals->on_update).publish(*this, e);
+    if (store->owner || signals)
+      return store->set.get(e.index); // packing may have moved it
     return comp;
   }
 
-  template <typename T> bool has(Entity e) {
+  // add<T> for an e that must not have T yet.
+  template <typename T, typename... Args>
+  T &emplace(Entity e, Args &&...args) {
+    assert(!has<T>(e));
+    return add<T>(e, std::forward<Args>(args)...);
+  }
+
+  // Replace the T of an e that must have it, in place. Publishes on_update.
+  template <typename T, typename... Args>
+  T &replace(Entity e, Args &&...args) {
+    assert(has<T>(e));
+    return add<T>(e, std::forward<Args>(args)...);
+  }
+
+  // add<T> for many entities: values[i] goes to ents[i]. Storage pages,
+  // dense arrays and masks are grown once before a tight fill loop.
+  template <typename T>
+  void add_bulk(Span<const Entity> ents, Span<const T> values) {
+    assert(ents.size() == values.size());
+    if (ents.empty())
+      return;
+    auto *store = get_or_create_storage<T>();
+    const size_t cid = store->comp_id;
+
+    scratch_indices.resize(ents.size());
+    for (size_t i = 0; i < ents.size(); ++i) {
+      assert(is_alive(ents[i]));
+      scratch_indices[i] = ents[i].index;
+    }
+    // which entities are new, for the signals: the mask bit is still clear
+    // for those, and only until their first entry in the batch
+    expand_masks_for_new_component();
+    ensure_entity_mask_size(versions.size());
+    auto *signals = store->signals.get();
+    // borrowed, so a listener that calls add_bulk gets its own
+    std::vector<bool> fresh = std::move(scratch_fresh);
+    fresh.clear();
+    for (uint32_t idx : scratch_indices) {
+      uint64_t *mask = mask_ptr_mut(idx);
+      if (signals)
+        fresh.push_back(!BitMaskHelper::test_bit(mask, cid));
+      BitMaskHelper::set_bit(mask, cid);
+    }
+    store->insert_bulk(scratch_indices.data(), values.data(), ents.size(),
+                       tick());
+
+    if (store->owner || !store->observers.empty())
+      for (Entity e : ents)
+        join_groups(*store, e);
+    for (size_t i = 0; signals && i < ents.size(); ++i)
+      (fresh[i] ? signals->on_construct : signals->on_update)
+          .publish(*this, ents[i]);
+    scratch_fresh = std::move(fresh);
+  }
+
+  // Answered from the entity mask: one bit test, no sparse probe.
+  template <typename T> bool has(Entity e) const {
     if (!is_alive(e))
       return false;
     auto *store = get_storage<T>();
     if (!store)
       return false;
-    return store->set.contains(e.index);
+    return BitMaskHelper::test_bit(mask_ptr(e.index), store->comp_id);
   }
 
+  // e must have T; never registers a storage. get<T> counts as a change of
+  // e's T for Changed<T> filters; get<const T> is read-only, writes
+  // nothing, and is what systems that only Reads<T> should call (they may
+  // run concurrently).
   template <typename T> T &get(Entity e) {
     assert(is_alive(e));
-    auto *store = get_or_create_storage<T>();
+    auto *store = get_storage<std::remove_const_t<T>>();
+    assert(store);
+    if constexpr (!std::is_const_v<T>)
+      store->stamp_changed(e.index, tick());
     return store->set.get(e.index);
   }
 
+  // Direct handle to the storage of T for hot loops that already know
+  // which entities have T. Stays valid for the lifetime of the world.
+  // Writes through it are not seen by Changed<T> filters.
+  template <typename T> class StorageHandle {
+  public:
+    // membership by entity index (the version is not checked)
+    bool contains(uint32_t index) const { return set->contains(index); }
+
+    // component of an entity index known to be present; no checks
+    T &get_unchecked(uint32_t index) const {
+      return set->get_unchecked(index);
+    }
+
+    size_t size() const { return set->size(); }
+
+  private:
+    friend class BasicECS;
+    explicit StorageHandle(ComponentSet<T> *set) : set(set) {}
+    ComponentSet<T> *set;
+  };
+
+  // Registers T if needed, so call it outside of parallel code.
+  template <typename T> StorageHandle<T> storage() {
+    return StorageHandle<T>(&get_or_create_storage<T>()->set);
+  }
+
+  // Publishes on_destroy while e still has T.
   template <typename T> void remove(Entity e) {
     if (!is_alive(e))
       return;
     auto *store = get_storage<T>();
-    if (!store)
+    if (!store || !store->set.contains(e.index))
       return;
-    store->set.erase(e.index);
+    if (store->signals)
+      store->signals->on_destroy.publish(*this, e);
+    if (store->tracked)
+      store->removals.push_back({e.index, e.version, tick()});
+    leave_groups(*store, e.index);
+    store->erase(e.index);
     reset_entity_bit(e.index, store->comp_id);
   }
 
+  // Apply fn(T&)... to e's T in order, then publish on_update. e must
+  // have T.
+  template <typename T, typename... Func> T &patch(Entity e, Func &&...fn) {
+    T &comp = get<T>(e);
+    (fn(comp), ...);
+    auto *store = get_storage<T>();
+    if (store->signals) {
+      store->signals->on_update.publish(*this, e);
+      return store->set.get(e.index);
+    }
+    return comp;
+  }
+
+  // -------------------------------------------
+  // Batched random access
+  // -------------------------------------------
+  // fn(Entity, Ts&...) for every alive entity of `ents` that has all Ts,
+  // in the order given. Lookups go through the storages' get_batch() a
+  // chunk at a time, so the sparse slots and components of the next
+  // entities are being fetched while fn runs: for shuffled handles this is
+  // much cheaper than has<T>() + get<T>() per entity. A const T reads
+  // without counting as a change. Never registers a storage.
+  template <typename... Ts, typename Func>
+  void for_each_of(Span<const Entity> ents, Func &&fn) {
+    static_assert(sizeof...(Ts) > 0, "for_each_of needs component types");
+    for_each_of_impl<Ts...>(ents, fn, std::index_sequence_for<Ts...>{});
+  }
+
+  // -------------------------------------------
+  // Component signals
+  // -------------------------------------------
+  // Listeners get (world, entity):
+  //   on_construct - after e gained T (it is in T's views and groups)
+  //   on_update    - after add<T> overwrote e's T, or after patch<T>
+  //   on_destroy   - before e loses T through remove<T>/destroy_entity;
+  //                  e is alive and still has T
+  // Listeners may touch other components and entities but must not add or
+  // remove T on e itself, and must not connect to the signal being
+  // published. Registers T if needed, so connect outside of parallel code.
+  using ComponentSignal = Signal<void(BasicECS &, Entity)>;
+
+  template <typename T> ComponentSignal &on_construct() {
+    return get_or_create_storage<T>()->signals_or_create().on_construct;
+  }
+  template <typename T> ComponentSignal &on_update() {
+    return get_or_create_storage<T>()->signals_or_create().on_update;
+  }
+  template <typename T> ComponentSignal &on_destroy() {
+    return get_or_create_storage<T>()->signals_or_create().on_destroy;
+  }
+
+  // -------------------------------------------
+  // Change ticks
+  // -------------------------------------------
+  // Stamp given to insertions and mutable accesses made now. Every query
+  // run advances it, so a query never sees its own writes as changes.
+  uint32_t tick() const { return change_tick.load(std::memory_order_relaxed); }
+
+  // End of a frame: one-shot views with change filters look back to here.
+  // Removals older than the previous frame are dropped from the logs.
+  void advance_frame() {
+    const uint32_t previous = frame_tick;
+    frame_tick = next_tick();
+    for (auto &st : component_storages)
+      st->prune_removals(previous);
+  }
+
+  // Start keeping ticks for T now instead of on the first view that
+  // filters on it. That first view registers tracking, which must not race
+  // with other threads using T, so call this before parallel code does.
+  template <typename T> void track_changes() {
+    auto *store = get_or_create_storage<T>();
+    if (!store->tracked)
+      store->start_tracking(tick());
+  }
+
+  // -------------------------------------------
+  // Memory
+  // -------------------------------------------
+  // Bytes held by the component storages and non-owning group lists.
+  // Entity versions and masks are not included.
+  struct MemoryStats {
+    size_t sparse_bytes = 0;    // sparse pages in use
+    size_t dense_bytes = 0;     // entity lists, components, change ticks
+    size_t pooled_bytes = 0;    // empty sparse pages kept for reuse
+    size_t reclaimed_bytes = 0; // emptied pages + shrink_to_fit(), so far
+  };
+
+  MemoryStats memory_stats() const {
+    MemoryStats stats;
+    for (auto &st : component_storages) {
+      stats.sparse_bytes += st->sparse_bytes();
+      stats.dense_bytes += st->dense_bytes();
+      stats.reclaimed_bytes += st->reclaimed_bytes();
+    }
+    for (auto &g : non_owning_groups) {
+      stats.sparse_bytes += g->matches.sparse_bytes();
+      stats.dense_bytes += g->matches.table_bytes();
+      stats.reclaimed_bytes += g->matches.reclaimed_bytes();
+    }
+    stats.pooled_bytes = page_pool.pooled_bytes();
+    return stats;
+  }
+
+  // Trim every storage to its contents and hand the pooled sparse pages
+  // back to the allocator. Returns the bytes released.
+  size_t shrink_to_fit() {
+    size_t freed = 0;
+    for (auto &st : component_storages)
+      freed += st->shrink_to_fit();
+    for (auto &g : non_owning_groups)
+      freed += g->matches.shrink_to_fit();
+    return freed + page_pool.trim();
+  }
+
   // -------------------------------------------
   // Groups: precomputed masks for sets of components
   // -------------------------------------------
@@ -197,7 +714,7 @@ public:
   // Create a group for a variadic list of component types
   template <typename... Components> Group create_group() {
     Group g;
-    g.required_mask.assign(mask_blocks, 0ull);
+    g.required_mask.assign(mask_blocks(), 0ull);
     (set_bit_in_mask(g.required_mask, component_id<Components>()), ...);
     return g;
   }
@@ -206,14 +723,18 @@ public:
   inline bool matches_group(Entity e, const Group &g) const {
     if (!is_alive(e))
       return false;
-    if (g.required_mask.size() != mask_blocks) {
+    if constexpr (MaxComponents > 0) {
+      // group masks are created at full width in fixed mode
+      return BitMaskHelper::test_mask_match<Masks::width()>(
+          mask_ptr(e.index), g.required_mask.data());
+    }
+    if (g.required_mask.size() != mask_blocks()) {
       // if group was created earlier, its mask might be smaller; treat missing
       // blocks as zeros -> expand necessary:
       // entity can't match bits outside group's mask anyway.
       // ensure sizes are compatible by checking available blocks only.
-      size_t min_blocks = std::min(g.required_mask.size(), mask_blocks);
-      const uint64_t *e_mask =
-          &entity_masks[static_cast<size_t>(e.index) * mask_blocks];
+      size_t min_blocks = std::min(g.required_mask.size(), mask_blocks());
+      const uint64_t *e_mask = mask_ptr(e.index);
       const uint64_t *g_mask = &g.required_mask[0];
       // check min_blocks
       for (size_t i = 0; i < min_blocks; ++i)
@@ -225,50 +746,152 @@ public:
           return false;
       return true;
     } else {
-      const uint64_t *e_mask =
-          &entity_masks[static_cast<size_t>(e.index) * mask_blocks];
+      const uint64_t *e_mask = mask_ptr(e.index);
       return BitMaskHelper::test_mask_match(e_mask, g.required_mask.data(),
-                                            mask_blocks);
+                                            mask_blocks());
     }
   }
 
-  template <typename T1, typename... Ts, typename Func> void view(Func &&fn) {
-    // Ensure T1 storage exists
-    auto *s1 = get_storage<T1>();
-    if (!s1)
-      return;
+  // -------------------------------------------
+  // Owning groups: storages packed in lockstep
+  // -------------------------------------------
+  // Handle over an owning group; see the definition after the class.
+  template <typename... Ts> class OwningGroup;
+
+  // Create (or fetch) the owning group over Ts.... From then on, every
+  // entity that has all of Ts sits at the same position [0, size()) in each
+  // of the Ts storages, so iteration is a linear walk over parallel arrays.
+  // A storage can be owned by only one group.
+  template <typename T1, typename T2, typename... Ts>
+  OwningGroup<T1, T2, Ts...> owning_group() {
+    static_assert(!(ComponentSet<T1>::in_place_delete ||
+                    ComponentSet<T2>::in_place_delete ||
+                    (ComponentSet<Ts>::in_place_delete || ...)),
+                  "owning groups reorder storages; in_place_delete types "
+                  "promise stable addresses");
+    std::array<IStorageBase *, 2 + sizeof...(Ts)> owned = {
+        get_or_create_storage<T1>(), get_or_create_storage<T2>(),
+        get_or_create_storage<Ts>()...};
+
+    OwningGroupData *data = owned[0]->owner;
+    if (data) {
+      // same group requested again: return a handle to it
+      assert(data->owned.size() == owned.size());
+      for (auto *st : owned)
+        assert(st->owner == data);
+    } else {
+      owning_groups.push_back(std::make_unique<OwningGroupData>());
+      data = owning_groups.back().get();
+      for (auto *st : owned) {
+        assert(!st->owner && "storage is already owned by another group");
+        st->owner = data;
+        data->owned.push_back(st);
+      }
 
-    // Gather all storages
-    std::array<IStorageBase *, 1 + sizeof...(Ts)> stores = {
-        s1, get_storage<Ts>()...};
+      // pack the entities that already match
+      for (uint32_t ent : entities_in_all(owned))
+        pack_into_group(*data, ent);
+    }
+    return OwningGroup<T1, T2, Ts...>(this, data);
+  }
 
-    // If any storage is missing → no matching entities
-    for (auto *st : stores)
-      if (!st)
-        return;
+  // -------------------------------------------
+  // Non-owning groups: incrementally maintained match lists
+  // -------------------------------------------
+  // Handle over a non-owning group; see the definition after the class.
+  template <typename... Ts> class NonOwningGroup;
+
+  // Create (or fetch) the non-owning group over Ts.... It is built from a
+  // Group mask (create_group<Ts...>()) and keeps the entities passing
+  // matches_group() in its own dense list, so iterating it costs O(matches)
+  // with no mask tests. Storages are left untouched, so any number of
+  // non-owning groups can share a component type.
+  template <typename T1, typename T2, typename... Ts>
+  NonOwningGroup<T1, T2, Ts...> non_owning_group() {
+    std::array<IStorageBase *, 2 + sizeof...(Ts)> observed = {
+        get_or_create_storage<T1>(), get_or_create_storage<T2>(),
+        get_or_create_storage<Ts>()...};
+    Group mask = create_group<T1, T2, Ts...>();
+
+    for (auto &g : non_owning_groups)
+      if (g->group.required_mask == mask.required_mask)
+        return NonOwningGroup<T1, T2, Ts...>(this, g.get());
+
+    non_owning_groups.push_back(std::make_unique<NonOwningGroupData>());
+    NonOwningGroupData *data = non_owning_groups.back().get();
+    data->group = std::move(mask);
+    data->matches.use_pool(&page_pool);
+    for (auto *st : observed)
+      st->observers.push_back(data);
+
+    // collect the entities that already match
+    const std::vector<uint32_t> matching = entities_in_all(observed);
+    data->matches.insert_bulk(matching.data(), matching.size());
+    return NonOwningGroup<T1, T2, Ts...>(this, data);
+  }
 
-    // Pick the smallest storage to iterate
-    IStorageBase *best = stores[0];
-    for (auto *st : stores)
-      if (st->dense_size() < best->dense_size())
-        best = st;
+  // -------------------------------------------
+  // Views & queries
+  // -------------------------------------------
+  // Persistent query over Ts... without the types in Exclude (an
+  // exclude_t); see the definition after the class.
+  template <typename Exclude, typename... Ts> class BasicQuery;
+  template <typename... Ts> using Query = BasicQuery<exclude_t<>, Ts...>;
+
+  // Build a query that can be kept and re-run every frame. It caches the
+  // typed storages, the mask test and the driving storage, and only
+  // re-resolves them when a storage reports a structural change.
+  template <typename T1, typename... Ts> Query<T1, Ts...> query() {
+    return Query<T1, Ts...>(this);
+  }
 
-    // Precompute mask of required components
-    Group req;
-    req.required_mask.assign(mask_blocks, 0ull);
-    set_bits_in_mask_from_types<0, T1, Ts...>(req.required_mask);
+  template <typename T1, typename... Ts, typename... Ex>
+  BasicQuery<exclude_t<Ex...>, T1, Ts...> query(exclude_t<Ex...>) {
+    return BasicQuery<exclude_t<Ex...>, T1, Ts...>(this);
+  }
 
-    // Iterate
-    best->for_each_entity_idx([&](uint32_t ent_index, size_t dense_pos) {
-      const uint64_t *em = mask_ptr(ent_index);
+  // Iterate every entity that has all of T1, Ts... and call
+  // fn(Entity, T1&, Ts&...). One-shot form of query<T1, Ts...>().each(fn).
+  // Pointer parameters are optional and passed as T* (nullptr if absent);
+  // tag (empty) types filter but are not passed: view<Position, Selected>
+  // calls fn(Entity, Position&).
+  template <typename T1, typename... Ts, typename Func> void view(Func &&fn) {
+    Query<T1, Ts...>(this, frame_tick).each(fn);
+  }
 
-      if (!BitMaskHelper::test_mask_match(em, req.required_mask.data(),
-                                          mask_blocks))
-        return;
+  // Same, skipping every entity that has any of Ex...; the exclusion is
+  // part of the mask test, so excluded entities never reach fn.
+  template <typename T1, typename... Ts, typename... Ex, typename Func>
+  void view(exclude_t<Ex...>, Func &&fn) {
+    BasicQuery<exclude_t<Ex...>, T1, Ts...>(this, frame_tick).each(fn);
+  }
 
-      // Pass entity + components to fn
-      call_with_components<T1, Ts...>(ent_index, fn);
-    });
+  // Parallel view: splits the driving storage into chunks and runs them on
+  // `jobs` (JobSystem::global() if omitted), blocking until all are done.
+  //
+  // Contract: fn is called concurrently from several threads. It may read
+  // and write only the components it is handed (and its own thread-safe
+  // state); it must not add/remove components, create/destroy entities or
+  // access other entities' components.
+  template <typename T1, typename... Ts, typename Func>
+  void par_view(JobSystem &jobs, Func &&fn) {
+    Query<T1, Ts...>(this, frame_tick).par_each(jobs, fn);
+  }
+
+  template <typename T1, typename... Ts, typename Func>
+  void par_view(Func &&fn) {
+    par_view<T1, Ts...>(JobSystem::global(), fn);
+  }
+
+  template <typename T1, typename... Ts, typename... Ex, typename Func>
+  void par_view(JobSystem &jobs, exclude_t<Ex...>, Func &&fn) {
+    BasicQuery<exclude_t<Ex...>, T1, Ts...>(this, frame_tick)
+        .par_each(jobs, fn);
+  }
+
+  template <typename T1, typename... Ts, typename... Ex, typename Func>
+  void par_view(exclude_t<Ex...> ex, Func &&fn) {
+    par_view<T1, Ts...>(JobSystem::global(), ex, fn);
   }
 
 private:
@@ -276,30 +899,222 @@ private:
   // Low-level storage & bookkeeping
   // -------------------------------------------
 
-  // Interface that lets us iterate dense storage and fetch components
-  // generically.
+  // Type-erased part of a storage: what the ECS needs without knowing T.
+  struct OwningGroupData;
+  struct NonOwningGroupData;
+
   struct IStorageBase {
+    IStorageBase(size_t cid) : comp_id(cid) {}
     virtual ~IStorageBase() = default;
     virtual void erase_entity(uint32_t idx) = 0;
     virtual size_t dense_size() const = 0;
-    // iterate each (entityIndex, dense_pos) calling function
-    virtual void
-    for_each_entity_idx(std::function<void(uint32_t, size_t)> f) = 0;
+    virtual bool contains(uint32_t idx) const = 0;
+    virtual size_t dense_index(uint32_t idx) const = 0;
+    virtual void swap_dense(size_t a, size_t b) = 0;
+    virtual const std::vector<uint32_t> &dense_entities() const = 0;
+    // entities of ents in this storage, in order (out may be ents)
+    virtual size_t filter(Span<const uint32_t> ents, uint32_t *out) const = 0;
+    virtual size_t shrink_to_fit() = 0;
+    virtual size_t sparse_bytes() const = 0;
+    virtual size_t dense_bytes() const = 0;
+    virtual size_t reclaimed_bytes() const = 0;
+
+    size_t comp_id;
+    // bumped whenever an entity enters or leaves the storage; queries
+    // compare it against the value they last saw
+    uint64_t version = 0;
+    // owning group that keeps this storage packed (nullptr if none)
+    OwningGroupData *owner = nullptr;
+    // non-owning groups that list this component type
+    std::vector<NonOwningGroupData *> observers;
+
+    // see on_construct<T>() and friends; allocated on first use, so a
+    // storage nobody listens to pays one null check per operation
+    struct Signals {
+      Signal<void(BasicECS &, Entity)> on_construct;
+      Signal<void(BasicECS &, Entity)> on_update;
+      Signal<void(BasicECS &, Entity)> on_destroy;
+    };
+    std::unique_ptr<Signals> signals;
+
+    Signals &signals_or_create() {
+      if (!signals)
+        signals = std::make_unique<Signals>();
+      return *signals;
+    }
+
+    // Change ticks, kept once `tracked`: parallel to the dense array, the
+    // tick of each entry's insertion and of its last mutable access.
+    bool tracked = false;
+    std::vector<uint32_t> added_ticks;
+    std::vector<uint32_t> changed_ticks;
+
+    // entity that lost this component at `tick` (remove<T> only; destroyed
+    // entities can't be visited anyway)
+    struct Removal {
+      uint32_t index;
+      uint32_t version;
+      uint32_t tick;
+    };
+    std::vector<Removal> removals;
+
+    // Existing entries count as inserted and changed at `now`.
+    void start_tracking(uint32_t now) {
+      tracked = true;
+      added_ticks.assign(dense_size(), now);
+      changed_ticks.assign(dense_size(), now);
+    }
+
+    void stamp_changed(uint32_t idx, uint32_t now) {
+      if (tracked)
+        changed_ticks[dense_index(idx)] = now;
+    }
+
+    // Trim the tick arrays and the removal log; returns the bytes freed.
+    size_t shrink_bookkeeping() {
+      const size_t before = bookkeeping_bytes();
+      added_ticks.shrink_to_fit();
+      changed_ticks.shrink_to_fit();
+      removals.shrink_to_fit();
+      return before - bookkeeping_bytes();
+    }
+
+    size_t bookkeeping_bytes() const {
+      return (added_ticks.capacity() + changed_ticks.capacity()) *
+                 sizeof(uint32_t) +
+             removals.capacity() * sizeof(Removal);
+    }
+
+    // bytes released by shrink_bookkeeping() so far
+    size_t reclaimed_ticks = 0;
+
+    // Drop removals stamped at or before `tick`.
+    void prune_removals(uint32_t tick) {
+      removals.erase(std::remove_if(removals.begin(), removals.end(),
+                                    [&](const Removal &r) {
+                                      return !newer(r.tick, tick);
+                                    }),
+                     removals.end());
+    }
+  };
+
+  // Bookkeeping of one owning group: entities in [0, len) of every owned
+  // storage have all owned components and are stored in the same order.
+  struct OwningGroupData {
+    std::vector<IStorageBase *> owned;
+    size_t len = 0;
+  };
+
+  // Bookkeeping of one non-owning group: the entities matching `group`.
+  struct NonOwningGroupData {
+    Group group;
+    EntitySet<uint32_t> matches;
   };
 
   // T-specific storage wrapper that implements IStorageBase
+  // Tag (empty) types get a TagSet: no component array at all.
   template <typename T> struct Storage : IStorageBase {
-    Storage(size_t cid) : comp_id(cid) {}
-    size_t comp_id;
-    SparseSet<T> set;
+    static_assert(ComponentTraits<T>::page_size > 0 ||
+                      !ComponentTraits<T>::in_place_delete,
+                  "in_place_delete needs page_size > 0");
+    using value_type = T;
+    Storage(size_t cid) : IStorageBase(cid) {}
+    ComponentSet<T> set;
+
+    // Insert or overwrite, constructing T from args in place.
+    template <typename... Args>
+    T &emplace(uint32_t idx, uint32_t now, Args &&...args) {
+      const bool fresh = !set.contains(idx);
+      if (fresh)
+        ++this->version;
+      T &comp = set.emplace(idx, std::forward<Args>(args)...);
+      if (this->tracked) {
+        const size_t at = set.index_of(idx);
+        if (at == this->added_ticks.size()) {
+          this->added_ticks.push_back(now);
+          this->changed_ticks.push_back(now);
+        } else {
+          // overwrite, or a reused hole
+          if (fresh)
+            this->added_ticks[at] = now;
+          this->changed_ticks[at] = now;
+        }
+      }
+      return comp;
+    }
 
-    void erase_entity(uint32_t idx) override { set.erase(idx); }
-    size_t dense_size() const override { return set.entities().size(); }
+    void insert_bulk(const uint32_t *idx, const T *values, size_t n,
+                     uint32_t now) {
+      if constexpr (ComponentSet<T>::in_place_delete) {
+        // new entries may land in holes: stamp them one by one
+        if (this->tracked) {
+          for (size_t i = 0; i < n; ++i)
+            emplace(idx[i], now, values[i]);
+          return;
+        }
+      }
+      set.insert_bulk(idx, values, n);
+      ++this->version;
+      if (this->tracked) {
+        // new entries are appended; overwritten ones only changed
+        this->added_ticks.resize(dense_size(), now);
+        this->changed_ticks.resize(dense_size(), now);
+        for (size_t i = 0; i < n; ++i)
+          this->changed_ticks[set.index_of(idx[i])] = now;
+      }
+    }
 
-    void for_each_entity_idx(std::function<void(uint32_t, size_t)> f) override {
-      const auto &ents = set.entities();
-      for (size_t i = 0; i < ents.size(); ++i)
-        f(ents[i], i);
+    void erase(uint32_t idx) {
+      if (!set.contains(idx))
+        return;
+      if (this->tracked && !ComponentSet<T>::in_place_delete) {
+        // mirror the set's swap-remove (holes keep their stale ticks)
+        const size_t at = set.index_of(idx);
+        this->added_ticks[at] = this->added_ticks.back();
+        this->changed_ticks[at] = this->changed_ticks.back();
+        this->added_ticks.pop_back();
+        this->changed_ticks.pop_back();
+      }
+      set.erase(idx);
+      ++this->version;
+    }
+
+    void erase_entity(uint32_t idx) override { erase(idx); }
+    size_t dense_size() const override { return set.entities().size(); }
+    bool contains(uint32_t idx) const override { return set.contains(idx); }
+    size_t dense_index(uint32_t idx) const override {
+      return set.index_of(idx);
+    }
+    void swap_dense(size_t a, size_t b) override {
+      set.swap_dense(a, b);
+      if (this->tracked) {
+        std::swap(this->added_ticks[a], this->added_ticks[b]);
+        std::swap(this->changed_ticks[a], this->changed_ticks[b]);
+      }
+    }
+    const std::vector<uint32_t> &dense_entities() const override {
+      return set.entities();
+    }
+    size_t filter(Span<const uint32_t> ents, uint32_t *out) const override {
+      return set.filter(ents, out);
+    }
+    size_t shrink_to_fit() override {
+      const size_t freed = set.shrink_to_fit();
+      if (this->tracked) {
+        // trailing holes may have been dropped from the dense range
+        this->added_ticks.resize(dense_size());
+        this->changed_ticks.resize(dense_size());
+      }
+      const size_t ticks = this->shrink_bookkeeping();
+      this->reclaimed_ticks += ticks;
+      return freed + ticks;
+    }
+    size_t sparse_bytes() const override { return set.sparse_bytes(); }
+    size_t dense_bytes() const override {
+      return set.dense_bytes() + this->bookkeeping_bytes();
+    }
+    size_t reclaimed_bytes() const override {
+      return set.reclaimed_bytes() + this->reclaimed_ticks;
     }
 
     // helper to get component reference if present
@@ -310,115 +1125,201 @@ private:
     }
   };
 
-  // mapping type_index -> Storage<T> pointer (polymorphic via IStorageBase)
-  std::unordered_map<std::type_index, std::unique_ptr<IStorageBase>>
-      component_storages;
+  // sparse pages shared by every set below; declared first so it outlives
+  // them
+  SparsePagePool<uint32_t> page_pool;
+
+  // owning list of storages, indexed by compact component id
+  std::vector<std::unique_ptr<IStorageBase>> component_storages;
+
+  // owning and non-owning groups created in this world
+  std::vector<std::unique_ptr<OwningGroupData>> owning_groups;
+  std::vector<std::unique_ptr<NonOwningGroupData>> non_owning_groups;
 
-  // map type_index -> component_id
-  std::unordered_map<std::type_index, size_t> type_to_id;
+  // family id -> storage (nullptr if the type was never used in this world)
+  std::vector<IStorageBase *> family_storages;
   size_t component_count; // number of registered component types
+  // bumped when a storage is registered, so queries built before a type
+  // existed know to look again
+  uint64_t storage_epoch = 0;
+
+  // current change tick (see tick()) and its value at advance_frame()
+  std::atomic<uint32_t> change_tick{1};
+  uint32_t frame_tick = 0;
+
+  // dense entry of a hole in an in_place_delete storage
+  static constexpr uint32_t TOMBSTONE = EntitySet<uint32_t>::TOMBSTONE;
 
   // per-entity versioning & free list
   std::vector<uint32_t> versions;
   std::vector<uint32_t> free_list;
 
-  // flat storage for entity masks: entity_masks[entity * mask_blocks +
-  // block_index]
-  std::vector<uint64_t> entity_masks;
-  size_t mask_blocks;
+  // entity indices of the batch being processed by a bulk call
+  std::vector<uint32_t> scratch_indices;
+  // add_bulk: whether each entity of the batch gained the component
+  std::vector<bool> scratch_fresh;
+  // per component id: entity indices to erase in destroy_entities
+  std::vector<std::vector<uint32_t>> scratch_buckets;
+  // indices destroy_entities has taken so far, recycled at its end
+  std::vector<uint32_t> scratch_doomed;
+  // nonzero while an index is in scratch_doomed
+  std::vector<uint8_t> scratch_marks;
+
+  // per-entity component masks (see DynamicMasks / FixedMasks)
+  Masks masks;
 
   // -------------------------------------------
   // Helpers: storage getters, mask ops, resizing
   // -------------------------------------------
-  template <typename T> Storage<T> *get_storage() {
-    auto it = component_storages.find(std::type_index(typeid(T)));
-    if (it == component_storages.end())
+  template <typename T> Storage<T> *get_storage() const {
+    const size_t family = ComponentFamily::id<T>();
+    if (family >= family_storages.size())
       return nullptr;
-    return static_cast<Storage<T> *>(it->second.get());
+    return static_cast<Storage<T> *>(family_storages[family]);
+  }
+
+  template <typename... Ts, typename Func, size_t... I>
+  void for_each_of_impl(Span<const Entity> ents, Func &fn,
+                        std::index_sequence<I...>) {
+    auto stores = std::make_tuple(get_storage<std::remove_const_t<Ts>>()...);
+    if (((std::get<I>(stores) == nullptr) || ...))
+      return;
+
+    constexpr size_t CHUNK = 256;
+    uint32_t idx[CHUNK];
+    bool alive[CHUNK];
+    std::tuple<std::array<std::remove_const_t<Ts> *, CHUNK>...> comps;
+    const uint32_t now = tick();
+    for (size_t base = 0; base < ents.size(); base += CHUNK) {
+      const size_t n = std::min(CHUNK, ents.size() - base);
+      for (size_t i = 0; i < n; ++i) {
+        idx[i] = ents[base + i].index;
+        alive[i] = is_alive(ents[base + i]);
+      }
+      const Span<const uint32_t> batch(idx, n);
+      (std::get<I>(stores)->set.get_batch(batch, std::get<I>(comps).data()),
+       ...);
+      for (size_t i = 0; i < n; ++i) {
+        if (!alive[i] || ((std::get<I>(comps)[i] == nullptr) || ...))
+          continue;
+        (
+            [&] {
+              if constexpr (!std::is_const_v<Ts>)
+                std::get<I>(stores)->stamp_changed(idx[i], now);
+            }(),
+            ...);
+        // const Ts reach fn as const references, as in views
+        fn(ents[base + i], static_cast<Ts &>(*std::get<I>(comps)[i])...);
+      }
+    }
+  }
+
+  // Entities present in every storage of `stores`, in the dense order of
+  // the smallest one: its list run through the others' filter(), which
+  // tests a few entities per SIMD gather (sparse_filter.h).
+  template <size_t K>
+  static std::vector<uint32_t>
+  entities_in_all(const std::array<IStorageBase *, K> &stores) {
+    IStorageBase *best = stores[0];
+    for (auto *st : stores)
+      if (st->dense_size() < best->dense_size())
+        best = st;
+    std::vector<uint32_t> ents = best->dense_entities();
+    ents.erase(std::remove(ents.begin(), ents.end(), TOMBSTONE), ents.end());
+    for (auto *st : stores)
+      if (st != best)
+        ents.resize(st->filter(ents, ents.data()));
+    return ents;
   }
 
   template <typename T> bool storage_exists() const {
-    return type_to_id.find(std::type_index(typeid(T))) != type_to_id.end();
+    return get_storage<T>() != nullptr;
   }
 
   template <typename T> Storage<T> *get_or_create_storage() {
-    auto it = component_storages.find(std::type_index(typeid(T)));
-    if (it != component_storages.end())
-      return static_cast<Storage<T> *>(it->second.get());
+    const size_t family = ComponentFamily::id<T>();
+    if (family < family_storages.size() && family_storages[family])
+      return static_cast<Storage<T> *>(family_storages[family]);
+
+    // register a new compact id and make room for it in every mask
+    size_t cid = component_count++;
+    expand_masks_for_new_component();
 
-    size_t cid = component_id<T>(); // registers a new id if necessary
     auto store = std::make_unique<Storage<T>>(cid);
+    store->set.use_pool(&page_pool);
     Storage<T> *ptr = store.get();
-    component_storages.emplace(std::type_index(typeid(T)), std::move(store));
+    component_storages.push_back(std::move(store));
+
+    if (family >= family_storages.size())
+      family_storages.resize(family + 1, nullptr);
+    family_storages[family] = ptr;
+    ++storage_epoch;
     return ptr;
   }
 
-  // called whenever component_count increases to expand masks & groups
-  void expand_masks_for_new_component() {
-    size_t new_blocks = BitMaskHelper::blocks_for_bits(component_count);
-    if (new_blocks == mask_blocks)
-      return;
+  // Hand out the current tick and move on to the next one.
+  uint32_t next_tick() {
+    return change_tick.fetch_add(1, std::memory_order_relaxed);
+  }
 
-    // create new masks vector sized versions.size() * new_blocks
-    std::vector<uint64_t> new_masks;
-    new_masks.assign(static_cast<size_t>(versions.size()) * new_blocks, 0ull);
+  // tick > since, tolerating wrap-around of the 32-bit counter
+  static bool newer(uint32_t tick, uint32_t since) {
+    return static_cast<int32_t>(tick - since) > 0;
+  }
 
-    // copy old masks into new layout
-    for (size_t ent = 0; ent < versions.size(); ++ent) {
-      const uint64_t *old_ptr = mask_ptr(ent);
-      uint64_t *new_ptr = &new_masks[ent * new_blocks];
-      if (mask_blocks > 0) {
-        for (size_t b = 0; b < mask_blocks; ++b)
-          new_ptr[b] = old_ptr[b];
-        for (size_t b = mask_blocks; b < new_blocks; ++b)
-          new_ptr[b] = 0;
-      }
-    }
+  // blocks per entity mask (a constant in fixed mode)
+  constexpr size_t mask_blocks() const { return masks.width(); }
 
-    entity_masks.swap(new_masks);
-    mask_blocks = new_blocks;
+  // called whenever component_count increases to expand masks & groups
+  void expand_masks_for_new_component() {
+    masks.grow_components(component_count, versions.size());
   }
 
-  // ensure entity_masks is large enough for 'entities' entities
+  // ensure masks exist for 'entities' entities
   void ensure_entity_mask_size(size_t entities) {
-    if (mask_blocks == 0) {
-      // still zero: make sure entity_masks has zero length entries
-      entity_masks.resize(entities * mask_blocks);
-      return;
-    }
-    if (entity_masks.size() < entities * mask_blocks) {
-      entity_masks.resize(entities * mask_blocks, 0ull);
-    }
+    masks.reserve_entities(entities);
   }
 
-  // returns pointer to entity's mask first block (may return pointer into empty
-  // vector)
+  // returns pointer to entity's mask first block (nullptr while no
+  // component type is registered in dynamic mode)
   inline uint64_t *mask_ptr_mut(size_t ent_index) {
-    if (mask_blocks == 0)
-      return nullptr;
-    return &entity_masks[ent_index * mask_blocks];
+    return masks.row(ent_index);
   }
 
   inline const uint64_t *mask_ptr(size_t ent_index) const {
-    if (mask_blocks == 0)
-      return nullptr;
-    return &entity_masks[ent_index * mask_blocks];
+    return masks.row(ent_index);
+  }
+
+  // Call fn(cid) for every bit in the mask of ent_index. The row is looked
+  // up again for each block, so fn may publish signals whose listeners
+  // create entities or register types (both reallocate the masks).
+  template <typename Func>
+  void for_each_mask_bit(size_t ent_index, Func &&fn) {
+    for (size_t b = 0; b < mask_blocks(); ++b)
+      for (uint64_t bits = mask_ptr(ent_index)[b]; bits; bits &= bits - 1)
+        fn(b * BitMaskHelper::BLOCK_BITS + BitMaskHelper::lowest_bit(bits));
+  }
+
+  inline void clear_mask(size_t ent_index) {
+    if (mask_blocks() == 0)
+      return;
+    uint64_t *mask = mask_ptr_mut(ent_index);
+    for (size_t i = 0; i < mask_blocks(); ++i)
+      mask[i] = 0;
   }
 
   inline void set_entity_bit(size_t ent_index, size_t comp_id) {
     // ensure masks large enough
     if (comp_id >= component_count)
       return; // should not happen
-    size_t needed_blocks = BitMaskHelper::blocks_for_bits(component_count);
-    if (needed_blocks != mask_blocks)
-      expand_masks_for_new_component();
+    expand_masks_for_new_component();
     ensure_entity_mask_size(versions.size());
     uint64_t *m = mask_ptr_mut(ent_index);
     BitMaskHelper::set_bit(m, comp_id);
   }
 
   inline void reset_entity_bit(size_t ent_index, size_t comp_id) {
-    if (mask_blocks == 0)
+    if (mask_blocks() == 0)
       return;
     uint64_t *m = mask_ptr_mut(ent_index);
     BitMaskHelper::reset_bit(m, comp_id);
@@ -431,40 +1332,643 @@ private:
     mask_vec[bidx] |= (uint64_t(1) << (bit % BitMaskHelper::BLOCK_BITS));
   }
 
-  // helper to set bits for variadic types in mask vector (used by view for
-  // precomputed req mask)
-  template <size_t I = 0, typename TFirst, typename... TRest>
-  static void
-  set_bits_in_mask_from_types_impl(std::vector<uint64_t> &mask_vec) {
-    (void)mask_vec; // placeholder
+  // ---------------------------------------------------------------------
+  // Group maintenance
+  // ---------------------------------------------------------------------
+
+  // Called after e gained the component stored in `store`.
+  void join_groups(IStorageBase &store, Entity e) {
+    for (auto *g : store.observers)
+      if (!g->matches.contains(e.index) && matches_group(e, g->group))
+        g->matches.insert(e.index);
+    if (store.owner)
+      pack_into_group(*store.owner, e.index);
   }
 
-  template <size_t I = 0, typename TFirst, typename... TRest>
-  void set_bits_in_mask_from_types(std::vector<uint64_t> &mask_vec) {
-    // expand mask_vec to current mask_blocks
-    if (mask_vec.size() < mask_blocks)
-      mask_vec.assign(mask_blocks, 0ull);
-    // set TFirst
-    set_bit_in_mask(mask_vec, component_id<TFirst>());
-    // set remaining recursively using fold-expression style
-    (set_bit_in_mask(mask_vec, component_id<TRest>()), ...);
+  // Called before ent loses the component stored in `store`.
+  void leave_groups(IStorageBase &store, uint32_t ent) {
+    if (store.owner)
+      unpack_from_group(*store.owner, ent);
+    for (auto *g : store.observers)
+      if (g->matches.contains(ent))
+        g->matches.erase(ent);
   }
 
-  // wrapper to call user function with components references
-  template <typename T1, typename... Ts, typename Func>
-  void call_with_components(uint32_t ent_index, Func &fn) {
-    T1 &c1 = get_storage<T1>()->set.get(ent_index);
-    // for others, we need to fetch each component reference
-    auto tup =
-        std::forward_as_tuple(c1, (get_storage<Ts>()->set.get(ent_index))...);
-    std::apply(
-        [&](auto &...args) {
-          fn(Entity{ent_index, versions[ent_index]}, args...);
-        },
-        tup);
+  // Move ent to position len of every owned storage if it now has all of
+  // them and is not packed yet.
+  void pack_into_group(OwningGroupData &g, uint32_t ent) {
+    const uint64_t *em = mask_ptr(ent);
+    for (auto *st : g.owned)
+      if (!BitMaskHelper::test_bit(em, st->comp_id))
+        return;
+    if (g.owned[0]->dense_index(ent) < g.len)
+      return;
+    for (auto *st : g.owned)
+      st->swap_dense(st->dense_index(ent), g.len);
+    ++g.len;
+  }
+
+  // Move ent just past the packed range (before one of its owned
+  // components goes away), keeping [0, len) intact.
+  void unpack_from_group(OwningGroupData &g, uint32_t ent) {
+    IStorageBase *first = g.owned[0];
+    if (!first->contains(ent) || first->dense_index(ent) >= g.len)
+      return;
+    --g.len;
+    for (auto *st : g.owned)
+      st->swap_dense(st->dense_index(ent), g.len);
+  }
+
+  // ---------------------------------------------------------------------
+  // View internals
+  // ---------------------------------------------------------------------
+
+  // Role of a view parameter P and the component type it refers to.
+  enum class ParamKind { REQUIRED, OPTIONAL, ADDED, CHANGED, REMOVED };
+
+  template <typename P> struct ViewParam {
+    using type = std::remove_const_t<P>;
+    static constexpr ParamKind kind = ParamKind::REQUIRED;
+    static constexpr bool writable = !std::is_const_v<P>;
+  };
+  template <typename P> struct ViewParam<P *> {
+    using type = std::remove_const_t<P>;
+    static constexpr ParamKind kind = ParamKind::OPTIONAL;
+    static constexpr bool writable = !std::is_const_v<P>;
+  };
+  template <typename T> struct ViewParam<Added<T>> {
+    using type = T;
+    static constexpr ParamKind kind = ParamKind::ADDED;
+    static constexpr bool writable = false;
+  };
+  template <typename T> struct ViewParam<Changed<T>> {
+    using type = T;
+    static constexpr ParamKind kind = ParamKind::CHANGED;
+    static constexpr bool writable = false;
+  };
+  template <typename T> struct ViewParam<Removed<T>> {
+    using type = T;
+    static constexpr ParamKind kind = ParamKind::REMOVED;
+    static constexpr bool writable = false;
+  };
+
+  // Stores entry of view parameter P. Only required, Added and Changed
+  // parameters can drive a view; operator-> lets the driver loops compile
+  // for every slot.
+  template <typename P> struct ViewStore {
+    using Param = ViewParam<P>;
+    using T = typename Param::type;
+    Storage<T> *store = nullptr;
+    Storage<T> *operator->() const { return store; }
+  };
+
+  // Per-candidate test of a view: mask terms for the required and excluded
+  // types, plus the storages whose changes can alter its outcome. Change
+  // filters compare ticks against `since`; writable parameters handed to
+  // fn are stamped with `stamp`.
+  template <size_t N> struct ViewFilter {
+    CompactMask<N> mask;
+    std::array<const IStorageBase *, N> watched{};
+    size_t watching = 0;
+    uint32_t since = 0;
+    uint32_t stamp = 0;
+
+    void require(const IStorageBase &st) {
+      mask.add(st.comp_id);
+      watched[watching++] = &st;
+    }
+
+    void exclude(const IStorageBase &st) {
+      mask.exclude(st.comp_id);
+      watched[watching++] = &st;
+    }
+
+    // versions only grow, so the sum changes iff a watched storage gained
+    // or lost an entity
+    uint64_t structure() const {
+      uint64_t sum = 0;
+      for (size_t i = 0; i < watching; ++i)
+        sum += watched[i]->version;
+      return sum;
+    }
+  };
+
+  // Select the driving storage at runtime, then run a loop specialized for it
+  template <typename Stores, size_t N, typename Func, size_t... Is>
+  void dispatch_view(Stores &stores, size_t driver,
+                     const ViewFilter<N> &filter, Func &fn,
+                     std::index_sequence<Is...> seq) {
+    ((driver == Is ? (view_driven_by<Is>(stores, filter, fn, seq), true)
+                   : false) ||
+     ...);
+  }
+
+  template <size_t D, typename Stores, size_t N, typename Func, size_t... Is>
+  void view_driven_by(Stores &stores, const ViewFilter<N> &filter, Func &fn,
+                      std::index_sequence<Is...> seq) {
+    using Param = typename std::tuple_element_t<D, Stores>::Param;
+    if constexpr (Param::kind == ParamKind::REMOVED)
+      view_removed_by<D>(stores, filter, fn, seq);
+    else if constexpr (Param::kind == ParamKind::ADDED ||
+                       Param::kind == ParamKind::CHANGED)
+      view_changed_by<D>(stores, filter, fn, seq);
+    else
+      view_dense_by<D>(stores, filter, fn, seq);
+  }
+
+  // The driver is filtered VIEW_FILTER_BLOCK candidates at a time and fn
+  // runs on the matches. fn may change structure: once a watched storage
+  // changed, filtering restarts right after the current position.
+  template <size_t D, typename Stores, size_t N, typename Func, size_t... Is>
+  void view_dense_by(Stores &stores, const ViewFilter<N> &filter, Func &fn,
+                     std::index_sequence<Is...> seq) {
+    using Set = decltype(std::get<D>(stores)->set);
+    const auto &ents = std::get<D>(stores)->set.entities();
+    uint32_t matches[VIEW_FILTER_BLOCK];
+    size_t pos = 0;
+    while (pos < ents.size()) {
+      const size_t n = std::min(VIEW_FILTER_BLOCK, ents.size() - pos);
+      const size_t found = filter_block<Set::in_place_delete>(
+          filter.mask, ents.data() + pos, n, matches);
+      const uint64_t seen = filter.structure();
+      size_t next = pos + n;
+      for (size_t k = 0; k < found; ++k) {
+        const size_t at = pos + matches[k];
+        visit_driven<D>(stores, filter, fn, ents[at], at, seq);
+        if (filter.structure() != seen) {
+          next = at + 1;
+          break;
+        }
+      }
+      pos = next;
+    }
+  }
+
+  // Driven by an Added/Changed filter: a sequential scan of its tick
+  // array picks the few recent entries, which then take the mask test.
+  template <size_t D, typename Stores, size_t N, typename Func, size_t... Is>
+  void view_changed_by(Stores &stores, const ViewFilter<N> &filter, Func &fn,
+                       std::index_sequence<Is...> seq) {
+    using Param = typename std::tuple_element_t<D, Stores>::Param;
+    auto *store = std::get<D>(stores).store;
+    const auto &ticks = Param::kind == ParamKind::ADDED ? store->added_ticks
+                                                         : store->changed_ticks;
+    const auto &ents = store->set.entities();
+    // size re-read every step: fn may shrink the storage. Holes keep
+    // stale ticks, so they are checked before the mask.
+    for (size_t pos = 0; pos < ents.size(); ++pos)
+      if (newer(ticks[pos], filter.since) && ents[pos] != TOMBSTONE &&
+          filter.mask.test(mask_ptr(ents[pos])))
+        visit_driven<D>(stores, filter, fn, ents[pos], pos, seq);
+  }
+
+  // Driven by a Removed filter: the entities in its removal log since
+  // filter.since, each visited once if it is alive and passes the test.
+  template <size_t D, typename Stores, size_t N, typename Func, size_t... Is>
+  void view_removed_by(Stores &stores, const ViewFilter<N> &filter, Func &fn,
+                       std::index_sequence<Is...> seq) {
+    const auto &log = std::get<D>(stores)->removals;
+    std::vector<Entity> candidates;
+    for (const auto &r : log)
+      if (newer(r.tick, filter.since))
+        candidates.push_back(Entity{r.index, r.version});
+    // by (index, version), so that repeats end up adjacent for unique()
+    std::sort(candidates.begin(), candidates.end(), [](Entity a, Entity b) {
+      return a.index != b.index ? a.index < b.index : a.version < b.version;
+    });
+    candidates.erase(std::unique(candidates.begin(), candidates.end()),
+                     candidates.end());
+    for (Entity e : candidates)
+      if (is_alive(e) && filter.mask.test(mask_ptr(e.index)))
+        visit_driven<D>(stores, filter, fn, e.index, 0, seq);
+  }
+
+  // Parallel form: the driver's dense range is split into chunks that run
+  // on `jobs`. The range is fixed up front, so fn must not change structure.
+  // Removal logs are short and walked on the calling thread.
+  template <typename Stores, size_t N, typename Func, size_t... Is>
+  void dispatch_par_view(JobSystem &jobs, Stores &stores, size_t driver,
+                         const ViewFilter<N> &filter, Func &fn,
+                         std::index_sequence<Is...> seq) {
+    ((driver == Is
+          ? (par_view_driven_by<Is>(jobs, stores, filter, fn, seq), true)
+          : false) ||
+     ...);
+  }
+
+  template <size_t D, typename Stores, size_t N, typename Func, size_t... Is>
+  void par_view_driven_by(JobSystem &jobs, Stores &stores,
+                          const ViewFilter<N> &filter, Func &fn,
+                          std::index_sequence<Is...> seq) {
+    using Param = typename std::tuple_element_t<D, Stores>::Param;
+    if constexpr (Param::kind == ParamKind::REMOVED) {
+      view_removed_by<D>(stores, filter, fn, seq);
+      return;
+    }
+    using Set = decltype(std::get<D>(stores)->set);
+    const uint32_t *ents = std::get<D>(stores)->set.entities().data();
+    const size_t n = std::get<D>(stores)->set.entities().size();
+    // a few chunks per thread so uneven match density still balances
+    const size_t chunk =
+        std::max<size_t>(1024, n / (jobs.thread_count() * 8));
+    jobs.parallel_for(n, chunk, [&](size_t begin, size_t end) {
+      uint32_t matches[VIEW_FILTER_BLOCK];
+      for (size_t pos = begin; pos < end; pos += VIEW_FILTER_BLOCK) {
+        const size_t count = std::min(VIEW_FILTER_BLOCK, end - pos);
+        const size_t found = filter_block<Set::in_place_delete>(
+            filter.mask, ents + pos, count, matches);
+        for (size_t k = 0; k < found; ++k)
+          visit_driven<D>(stores, filter, fn, ents[pos + matches[k]],
+                          pos + matches[k], seq);
+      }
+    });
+  }
+
+  // candidates tested per filter call in views
+  static constexpr size_t VIEW_FILTER_BLOCK = 64;
+
+  // Positions in ents[0, n) whose mask passes req, in order.
+  template <size_t N>
+  size_t filter_matches(const CompactMask<N> &req, const uint32_t *ents,
+                        size_t n, uint32_t *out) const {
+    // the AVX2 gather addresses mask words with 32-bit indices
+    assert(versions.size() * mask_blocks() < (size_t(1) << 31));
+    return mask_filter::filter_mask_matches(mask_ptr(0), mask_blocks(), ents,
+                                            n, req.blocks.data(),
+                                            req.care.data(), req.bits.data(),
+                                            req.terms, out);
+  }
+
+  // filter_matches over n <= VIEW_FILTER_BLOCK dense entries that may
+  // include holes; positions are relative to ents either way.
+  template <bool Holes, size_t N>
+  size_t filter_block(const CompactMask<N> &req, const uint32_t *ents,
+                      size_t n, uint32_t *out) const {
+    if constexpr (!Holes) {
+      return filter_matches(req, ents, n, out);
+    } else {
+      uint32_t live[VIEW_FILTER_BLOCK];
+      uint32_t where[VIEW_FILTER_BLOCK];
+      size_t count = 0;
+      for (size_t i = 0; i < n; ++i)
+        if (ents[i] != TOMBSTONE) {
+          live[count] = ents[i];
+          where[count++] = static_cast<uint32_t>(i);
+        }
+      const size_t found = filter_matches(req, live, count, out);
+      for (size_t k = 0; k < found; ++k)
+        out[k] = where[out[k]];
+      return found;
+    }
+  }
+
+  // Calls fn for a candidate that passed the mask test, if it also passes
+  // the change filters. `pos` is its dense position in the driver D.
+  template <size_t D, typename Stores, size_t N, typename Func, size_t... Is>
+  inline void visit_driven(Stores &stores, const ViewFilter<N> &filter,
+                           Func &fn, uint32_t ent, size_t pos,
+                           std::index_sequence<Is...>) {
+    if (!(recent_enough<D, Is>(stores, ent, pos, filter.since) && ...))
+      return;
+    call_with_args(fn, Entity{ent, versions[ent]},
+                   component_for_view<D, Is>(stores, ent, pos,
+                                             filter.stamp)...);
+  }
+
+  // fn(e, args...) where every part is a tuple of zero (tag) or one
+  // argument, so tags drop out of the call.
+  template <typename Func, typename... Parts>
+  static inline void call_with_args(Func &fn, Entity e, Parts &&...parts) {
+    std::apply([&](auto &&...args) { fn(e, args...); },
+               std::tuple_cat(std::forward<Parts>(parts)...));
+  }
+
+  // Added/Changed parameter I: ent's tick is newer than `since`.
+  template <size_t D, size_t I, typename Stores>
+  static inline bool recent_enough(Stores &stores, uint32_t ent, size_t pos,
+                                   uint32_t since) {
+    using Param = typename std::tuple_element_t<I, Stores>::Param;
+    if constexpr (Param::kind == ParamKind::ADDED ||
+                  Param::kind == ParamKind::CHANGED) {
+      auto *store = std::get<I>(stores).store;
+      const size_t at = I == D ? pos : store->set.index_of(ent);
+      const auto &ticks = Param::kind == ParamKind::ADDED
+                              ? store->added_ticks
+                              : store->changed_ticks;
+      return newer(ticks[at], since);
+    } else {
+      return true;
+    }
+  }
+
+  // Driving component by dense position, others through the sparse table;
+  // optional ones are looked up only if the entity's mask has their bit
+  // and are passed as pointers (tags included). Filters and required tags
+  // add no argument. Writable components of tracked storages are stamped.
+  template <size_t D, size_t I, typename Stores>
+  inline auto component_for_view(Stores &stores, uint32_t ent, size_t pos,
+                                 uint32_t stamp) {
+    using Param = typename std::tuple_element_t<I, Stores>::Param;
+    using T = typename Param::type;
+    using Ref = std::conditional_t<Param::writable, T &, const T &>;
+    using Ptr = std::conditional_t<Param::writable, T *, const T *>;
+    auto *store = std::get<I>(stores).store;
+    if constexpr (Param::kind == ParamKind::OPTIONAL) {
+      if (!store || !BitMaskHelper::test_bit(mask_ptr(ent), store->comp_id))
+        return std::tuple<Ptr>(nullptr);
+      if constexpr (Param::writable)
+        store->stamp_changed(ent, stamp);
+      return std::tuple<Ptr>(&store->set.get_unchecked(ent));
+    } else if constexpr (Param::kind != ParamKind::REQUIRED ||
+                         std::is_empty_v<T>) {
+      return std::tuple<>();
+    } else {
+      const size_t at = I == D ? pos : store->set.index_of(ent);
+      if constexpr (Param::writable)
+        if (store->tracked)
+          store->changed_ticks[at] = stamp;
+      return std::tuple<Ref>(store->set.dense_at(at));
+    }
   }
 };
 
+// -------------------------------------------------------------
+// BasicECS::BasicQuery<Exclude, Ts...> (persistent view)
+// -------------------------------------------------------------
+// Holds the typed storages, the mask test and the driving storage for
+// Ts... between runs. each() first compares the world's storage epoch and
+// every required storage's version with the values seen last time, so an
+// unchanged world costs N integer compares instead of storage discovery,
+// smallest-set selection and mask building.
+//
+// Pointer parameters in Ts... are optional and never drive the iteration.
+// Excluded types (Exclude = exclude_t<Ex...>) that have no storage yet
+// cannot be on any entity and add no mask term.
+//
+// Change filters (Added/Changed/Removed<T>) compare against the tick of the
+// previous run (`since` for the first one), and take over as the driver:
+// a Removed<T> query visits only T's removal log, an Added/Changed one
+// scans the tick array of its smallest filtered storage.
+//
+// The query keeps a pointer to its world; the world must outlive it.
+template <size_t MaxComponents>
+template <typename Exclude, typename... Ts>
+class BasicECS<MaxComponents>::BasicQuery {
+public:
+  static constexpr size_t N = sizeof...(Ts);
+  static constexpr size_t NX = Exclude::size;
+  static_assert(((ViewParam<Ts>::kind != ParamKind::OPTIONAL) || ...),
+                "a view needs at least one non-optional component");
+
+  explicit BasicQuery(BasicECS *world, uint32_t since = 0)
+      : world(world), last_run(since) {}
+
+  // fn(Entity, Ts&...) for every entity that has all of Ts and none of the
+  // excluded types; optional parameters are passed as pointers, required
+  // tags not at all
+  template <typename Func> void each(Func &&fn) {
+    if (!refresh())
+      return;
+    begin_run();
+    world->dispatch_view(stores, driver, filter, fn,
+                         std::make_index_sequence<N>{});
+  }
+
+  // Parallel each() on `jobs`; same contract as ECS::par_view.
+  template <typename Func> void par_each(JobSystem &jobs, Func &&fn) {
+    if (!refresh())
+      return;
+    begin_run();
+    world->dispatch_par_view(jobs, stores, driver, filter, fn,
+                             std::make_index_sequence<N>{});
+  }
+
+private:
+  static constexpr std::array<ParamKind, N> kinds = {ViewParam<Ts>::kind...};
+
+  static constexpr bool filters_changes(ParamKind k) {
+    return k == ParamKind::ADDED || k == ParamKind::CHANGED ||
+           k == ParamKind::REMOVED;
+  }
+
+  // This run sees ticks after the previous one; its own writes get a tick
+  // that the next run will not count.
+  void begin_run() {
+    filter.since = last_run;
+    filter.stamp = last_run = world->next_tick();
+  }
+
+  // Driver: a Removed<T> log, else the smallest Added/Changed storage,
+  // else the smallest required storage.
+  size_t pick_driver() const {
+    size_t best = N;
+    int best_rank = 0;
+    for (size_t i = 0; i < N; ++i) {
+      const int rank = kinds[i] == ParamKind::REMOVED   ? 3
+                       : filters_changes(kinds[i])      ? 2
+                       : kinds[i] == ParamKind::REQUIRED ? 1
+                                                         : 0;
+      if (rank > best_rank ||
+          (rank == best_rank && rank > 0 &&
+           bases[i]->dense_size() < bases[best]->dense_size())) {
+        best = i;
+        best_rank = rank;
+      }
+    }
+    return best;
+  }
+
+  template <typename... Ex>
+  std::array<IStorageBase *, NX> excluded_storages(exclude_t<Ex...>) const {
+    return {world->get_storage<Ex>()...};
+  }
+
+  // Returns false while some required storage does not exist yet.
+  bool refresh() {
+    bool changed = false;
+    if (seen_epoch != world->storage_epoch) {
+      seen_epoch = world->storage_epoch;
+      stores = std::make_tuple(ViewStore<Ts>{
+          world->get_storage<typename ViewParam<Ts>::type>()}...);
+      bases = {world->get_storage<typename ViewParam<Ts>::type>()...};
+      complete = true;
+      filter = ViewFilter<N + NX>();
+      for (size_t i = 0; i < N && complete; ++i) {
+        if (kinds[i] == ParamKind::OPTIONAL)
+          continue;
+        if (!bases[i]) {
+          complete = false;
+          break;
+        }
+        if (kinds[i] == ParamKind::REMOVED)
+          filter.exclude(*bases[i]);
+        else
+          filter.require(*bases[i]);
+        if (filters_changes(kinds[i]) && !bases[i]->tracked)
+          bases[i]->start_tracking(world->tick());
+      }
+      for (auto *st : excluded_storages(Exclude{}))
+        if (st)
+          filter.exclude(*st);
+      changed = true;
+    }
+    if (!complete)
+      return false;
+
+    for (size_t i = 0; i < N; ++i)
+      if (kinds[i] != ParamKind::OPTIONAL &&
+          bases[i]->version != seen_versions[i]) {
+        seen_versions[i] = bases[i]->version;
+        changed = true;
+      }
+
+    if (changed)
+      driver = pick_driver();
+    return true;
+  }
+
+  BasicECS *world;
+  uint32_t last_run; // tick of the previous run
+  std::tuple<ViewStore<Ts>...> stores{};
+  std::array<IStorageBase *, N> bases{};
+  std::array<uint64_t, N> seen_versions{};
+  uint64_t seen_epoch = ~uint64_t(0);
+  bool complete = false;
+  ViewFilter<N + NX> filter;
+  size_t driver = 0;
+};
+
+// -------------------------------------------------------------
+// BasicECS::OwningGroup<Ts...>
+// -------------------------------------------------------------
+// Lightweight handle returned by ECS::owning_group<Ts...>(). The packed range
+// is maintained by the world on add/remove/destroy_entity; iterating it needs
+// no mask tests and no sparse lookups.
+template <size_t MaxComponents>
+template <typename... Ts>
+class BasicECS<MaxComponents>::OwningGroup {
+public:
+  OwningGroup(BasicECS *world, OwningGroupData *data)
+      : world(world), data(data), stores(world->get_storage<Ts>()...) {}
+
+  // number of entities that have all of Ts
+  size_t size() const { return data->len; }
+
+  // fn(Entity, Ts&...) for every entity in the group (tags not passed).
+  // Counts as a change of every packed component for Changed<T> filters.
+  template <typename Func> void each(Func &&fn) {
+    each_impl(fn, std::make_index_sequence<sizeof...(Ts)>{});
+  }
+
+private:
+  template <typename Func, size_t... Is>
+  void each_impl(Func &fn, std::index_sequence<Is...>) {
+    const uint32_t *ents = std::get<0>(stores)->set.entities().data();
+    auto arrays = std::make_tuple(dense_array(std::get<Is>(stores))...);
+    const size_t n = data->len;
+    const uint32_t now = world->tick();
+    for (IStorageBase *st :
+         {static_cast<IStorageBase *>(std::get<Is>(stores))...})
+      if (st->tracked)
+        std::fill_n(st->changed_ticks.begin(), n, now);
+    for (size_t i = 0; i < n; ++i)
+      call_with_args(fn, Entity{ents[i], world->versions[ents[i]]},
+                     component_at(std::get<Is>(arrays), i)...);
+  }
+
+  // Packed component array of a storage; tags have none, and paged
+  // storages are reached through their set.
+  struct NoArray {};
+  template <typename Set> struct PagedArray {
+    Set *set;
+  };
+  template <typename T> static inline auto dense_array(Storage<T> *store) {
+    if constexpr (std::is_empty_v<T>)
+      return NoArray{};
+    else if constexpr (std::is_same_v<ComponentSet<T>, SparseSet<T>>)
+      return store->set.data().data();
+    else
+      return PagedArray<ComponentSet<T>>{&store->set};
+  }
+
+  template <typename T> static inline auto component_at(T *array, size_t i) {
+    return std::tuple<T &>(array[i]);
+  }
+  template <typename Set>
+  static inline auto component_at(PagedArray<Set> array, size_t i) {
+    return std::tuple<decltype(array.set->dense_at(i))>(array.set->dense_at(i));
+  }
+  static inline std::tuple<> component_at(NoArray, size_t) { return {}; }
+
+  BasicECS *world;
+  OwningGroupData *data;
+  std::tuple<Storage<Ts> *...> stores;
+};
+
+// -------------------------------------------------------------
+// BasicECS::NonOwningGroup<Ts...>
+// -------------------------------------------------------------
+// Lightweight handle returned by ECS::non_owning_group<Ts...>(). Components
+// are fetched through each storage's sparse table; call sort() after large
+// batches of changes to walk the matches in entity order.
+template <size_t MaxComponents>
+template <typename... Ts>
+class BasicECS<MaxComponents>::NonOwningGroup {
+public:
+  NonOwningGroup(BasicECS *world, NonOwningGroupData *data)
+      : world(world), data(data), stores(world->get_storage<Ts>()...) {}
+
+  // number of entities that have all of Ts
+  size_t size() const { return data->matches.size(); }
+
+  // dense list of matching entity indices
+  const std::vector<uint32_t> &entities() const {
+    return data->matches.entities();
+  }
+
+  // order the match list by entity index for cache-friendly lookups
+  void sort() { data->matches.sort(); }
+
+  // fn(Entity, Ts&...) for every entity in the group (tags not passed).
+  // Counts as a change of ent's components for Changed<T> filters.
+  template <typename Func> void each(Func &&fn) {
+    each_impl(fn, std::make_index_sequence<sizeof...(Ts)>{});
+  }
+
+private:
+  template <typename Func, size_t... Is>
+  void each_impl(Func &fn, std::index_sequence<Is...>) {
+    const auto &ents = data->matches.entities();
+    const uint32_t now = world->tick();
+    for (size_t i = 0; i < ents.size(); ++i) {
+      const uint32_t ent = ents[i];
+      call_with_args(fn, Entity{ent, world->versions[ent]},
+                     component(std::get<Is>(stores), ent, now)...);
+    }
+  }
+
+  // Component of ent as a callback argument; tags add none.
+  template <typename T>
+  static inline auto component(Storage<T> *store, uint32_t ent,
+                               uint32_t now) {
+    if constexpr (std::is_empty_v<T>) {
+      return std::tuple<>();
+    } else {
+      const size_t at = store->set.index_of(ent);
+      if (store->tracked)
+        store->changed_ticks[at] = now;
+      return std::tuple<T &>(store->set.dense_at(at));
+    }
+  }
+
+  BasicECS *world;
+  NonOwningGroupData *data;
+  std::tuple<Storage<Ts> *...> stores;
+};
+
+// Default world: mask width follows the number of registered types.
+using ECS = BasicECS<0>;
+
 namespace std {
 template <> struct hash<Entity> {
   size_t operator()(const Entity &e) const noexcept {
@@ -0,0 +1,502 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//
+// Work-stealing job system
+//
+// Design notes:
+// - One slot per participating thread: slot 0 belongs to the thread that
+//   constructed the JobSystem, slots 1..N-1 to the workers it starts.
+// - Every slot owns a fixed-capacity Chase-Lev deque. The owner pushes and
+//   pops at the bottom (LIFO, cache-warm); idle threads steal from the top
+//   of a random victim (FIFO, oldest = usually largest piece of work).
+// - Jobs are 64-byte records holding a function pointer, the Counter to
+//   signal and up to 48 bytes of inline closure state (larger closures are
+//   boxed on the heap). Records are recycled through per-slot free lists.
+// - A Counter tracks outstanding jobs. wait(counter) does not block: the
+//   waiting thread keeps executing jobs until the counter drains, so nested
+//   waits inside jobs cannot deadlock the pool.
+// - Dependencies: spawn_after(dep, fn) parks fn on `dep` and submits it
+//   once every job counted by `dep` has finished.
+// - parallel_for recursively halves its range into jobs, so thieves take
+//   big halves and the owner keeps working on the small end.
+// - Threads that are neither the owner nor a worker submit through a locked
+//   injection queue.
+//
+// Idle workers spin briefly and then sleep on a condition variable until
+// new work is pushed.
+//
+class JobSystem {
+public:
+  struct Job;
+
+  // Number of outstanding jobs spawned against it (plus parked
+  // continuations). Must outlive every job that references it.
+  class Counter {
+  public:
+    Counter() = default;
+    Counter(const Counter &) = delete;
+    Counter &operator=(const Counter &) = delete;
+
+    // true once every counted job finished and released the counter
+    bool done() const {
+      return pending.load(std::memory_order_acquire) == 0 &&
+             finishing.load(std::memory_order_acquire) == 0;
+    }
+
+  private:
+    friend class JobSystem;
+    std::atomic<int> pending{0};
+    // finishers currently between their decrement and their last access;
+    // done() waits for them so the counter can be destroyed right after
+    std::atomic<int> finishing{0};
+    std::mutex mutex; // guards continuations
+    std::vector<Job *> continuations;
+  };
+
+  // Executed / stolen job totals across all slots.
+  struct Stats {
+    uint64_t executed = 0;
+    uint64_t stolen = 0;
+  };
+
+  // `threads` counts every participant, including the constructing thread,
+  // so JobSystem(1) runs everything inline on the caller.
+  explicit JobSystem(size_t threads = default_thread_count())
+      : owner(std::this_thread::get_id()) {
+    threads = std::max<size_t>(threads, 1);
+    for (size_t i = 0; i < threads; ++i)
+      slots.push_back(std::make_unique<Slot>(uint32_t(i * 2654435761u + 1)));
+    for (size_t i = 1; i < threads; ++i)
+      workers.emplace_back([this, i] { worker_loop(i); });
+  }
+
+  ~JobSystem() {
+    {
+      std::lock_guard<std::mutex> lk(sleep_mutex);
+      stopping = true;
+    }
+    sleep_cv.notify_all();
+    for (auto &w : workers)
+      w.join();
+    for (auto &slot : slots)
+      for (Job *job : slot->free_jobs)
+        delete job;
+  }
+
+  JobSystem(const JobSystem &) = delete;
+  JobSystem &operator=(const JobSystem &) = delete;
+
+  // Process-wide job system sized to the hardware. Slot 0 belongs to the
+  // thread that first calls global() (normally the main thread).
+  static JobSystem &global() {
+    static JobSystem jobs;
+    return jobs;
+  }
+
+  static size_t default_thread_count() {
+    return std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  // number of threads that execute jobs (workers + owner)
+  size_t thread_count() const { return slots.size(); }
+
+  // Index of the calling thread in [0, thread_count()), or thread_count()
+  // for threads that don't belong to this system. Lets callers keep
+  // per-thread state (e.g. command buffers) without locking.
+  size_t thread_index() const {
+    size_t slot = current_slot();
+    return slot == NO_SLOT ? slots.size() : slot;
+  }
+
+  // -------------------------------------------
+  // Spawning & waiting
+  // -------------------------------------------
+  // Run fn() as a job; `counter` (optional) is incremented now and
+  // decremented when fn returns.
+  template <typename Func> void spawn(Func &&fn, Counter *counter = nullptr) {
+    if (counter)
+      counter->pending.fetch_add(1, std::memory_order_relaxed);
+    submit(make_job(std::forward<Func>(fn), counter));
+  }
+
+  // Run fn() once every job counted by `dependency` has finished.
+  template <typename Func>
+  void spawn_after(Counter &dependency, Func &&fn,
+                   Counter *counter = nullptr) {
+    if (counter)
+      counter->pending.fetch_add(1, std::memory_order_relaxed);
+    Job *job = make_job(std::forward<Func>(fn), counter);
+    {
+      std::lock_guard<std::mutex> lk(dependency.mutex);
+      if (dependency.pending.load(std::memory_order_acquire) != 0) {
+        dependency.continuations.push_back(job);
+        return;
+      }
+    }
+    submit(job);
+  }
+
+  // Execute jobs on the calling thread until `counter` drains.
+  void wait(const Counter &counter) {
+    wait_until([&counter] { return counter.done(); });
+  }
+
+  // Execute jobs on the calling thread until done() returns true. Lets a
+  // caller wait on its own condition (e.g. "main-thread work is ready").
+  template <typename Pred> void wait_until(Pred &&done) {
+    const size_t slot = current_slot();
+    unsigned idle_rounds = 0;
+    while (!done()) {
+      if (run_one(slot)) {
+        idle_rounds = 0;
+      } else if (++idle_rounds > 64) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  // Call fn(begin, end) for ranges of at most `chunk` items covering
+  // [0, count), in parallel, and return when all of them are done.
+  template <typename Func>
+  void parallel_for(size_t count, size_t chunk, Func &&fn) {
+    if (count == 0)
+      return;
+    chunk = std::max<size_t>(chunk, 1);
+    if (slots.size() == 1 || count <= chunk) {
+      fn(size_t(0), count);
+      return;
+    }
+    Counter counter;
+    spawn_range(0, count, chunk, fn, counter);
+    wait(counter);
+  }
+
+  Stats stats() const {
+    Stats s;
+    for (auto &slot : slots) {
+      s.executed += slot->executed.load(std::memory_order_relaxed);
+      s.stolen += slot->stolen.load(std::memory_order_relaxed);
+    }
+    return s;
+  }
+
+  void reset_stats() {
+    for (auto &slot : slots) {
+      slot->executed.store(0, std::memory_order_relaxed);
+      slot->stolen.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  // -------------------------------------------
+  // Job record
+  // -------------------------------------------
+  static constexpr size_t JOB_SIZE = 64;
+  static constexpr size_t JOB_INLINE_BYTES = JOB_SIZE - 2 * sizeof(void *);
+
+  struct alignas(JOB_SIZE) Job {
+    void (*invoke)(Job *); // runs (and destroys) the stored closure
+    Counter *counter;
+    alignas(16) unsigned char storage[JOB_INLINE_BYTES];
+  };
+  static_assert(sizeof(Job) == JOB_SIZE, "Job must fill one cache line");
+
+private:
+  static constexpr size_t NO_SLOT = ~size_t(0);
+
+  // -------------------------------------------
+  // Chase-Lev deque (fixed capacity)
+  // -------------------------------------------
+  class Deque {
+  public:
+    static constexpr int64_t CAPACITY = 8192;
+    static constexpr int64_t MASK = CAPACITY - 1;
+
+    Deque() {
+      for (auto &cell : buffer)
+        cell.store(nullptr, std::memory_order_relaxed);
+    }
+
+    // owner only; false when full
+    bool push(Job *job) {
+      int64_t b = bottom.load(std::memory_order_relaxed);
+      int64_t t = top.load(std::memory_order_acquire);
+      if (b - t >= CAPACITY)
+        return false;
+      buffer[b & MASK].store(job, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      bottom.store(b + 1, std::memory_order_relaxed);
+      return true;
+    }
+
+    // owner only
+    Job *pop() {
+      int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+      bottom.store(b, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      int64_t t = top.load(std::memory_order_relaxed);
+      if (t > b) {
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+      }
+      Job *job = buffer[b & MASK].load(std::memory_order_relaxed);
+      if (t == b) {
+        // last item: race against thieves for it
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                         std::memory_order_relaxed))
+          job = nullptr;
+        bottom.store(b + 1, std::memory_order_relaxed);
+      }
+      return job;
+    }
+
+    // any thread
+    Job *steal() {
+      int64_t t = top.load(std::memory_order_acquire);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      int64_t b = bottom.load(std::memory_order_acquire);
+      if (t >= b)
+        return nullptr;
+      Job *job = buffer[t & MASK].load(std::memory_order_relaxed);
+      if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                       std::memory_order_relaxed))
+        return nullptr;
+      return job;
+    }
+
+  private:
+    alignas(64) std::atomic<int64_t> top{0};
+    alignas(64) std::atomic<int64_t> bottom{0};
+    alignas(64) std::atomic<Job *> buffer[CAPACITY];
+  };
+
+  struct alignas(64) Slot {
+    explicit Slot(uint32_t seed) : rng(seed) {}
+    Deque deque;
+    std::vector<Job *> free_jobs; // touched by the owning thread only
+    std::atomic<uint64_t> executed{0};
+    std::atomic<uint64_t> stolen{0};
+    uint32_t rng;
+  };
+
+  // -------------------------------------------
+  // Job construction & execution
+  // -------------------------------------------
+  template <typename Func> Job *make_job(Func &&fn, Counter *counter) {
+    using F = std::decay_t<Func>;
+    Job *job = allocate_job();
+    job->counter = counter;
+    if constexpr (sizeof(F) <= JOB_INLINE_BYTES && alignof(F) <= 16) {
+      new (job->storage) F(std::forward<Func>(fn));
+      job->invoke = [](Job *j) {
+        F *f = std::launder(reinterpret_cast<F *>(j->storage));
+        (*f)();
+        f->~F();
+      };
+    } else {
+      F *boxed = new F(std::forward<Func>(fn));
+      std::memcpy(job->storage, &boxed, sizeof(boxed));
+      job->invoke = [](Job *j) {
+        F *f;
+        std::memcpy(&f, j->storage, sizeof(f));
+        (*f)();
+        delete f;
+      };
+    }
+    return job;
+  }
+
+  Job *allocate_job() {
+    const size_t slot = current_slot();
+    if (slot != NO_SLOT && !slots[slot]->free_jobs.empty()) {
+      Job *job = slots[slot]->free_jobs.back();
+      slots[slot]->free_jobs.pop_back();
+      return job;
+    }
+    return new Job;
+  }
+
+  void release_job(Job *job, size_t slot) {
+    if (slot != NO_SLOT)
+      slots[slot]->free_jobs.push_back(job);
+    else
+      delete job;
+  }
+
+  void submit(Job *job) {
+    const size_t slot = current_slot();
+    if (slot != NO_SLOT) {
+      if (!slots[slot]->deque.push(job)) {
+        execute(job, slot); // deque full: run it right here
+        return;
+      }
+    } else {
+      std::lock_guard<std::mutex> lk(injection_mutex);
+      injection.push_back(job);
+    }
+    queued.fetch_add(1, std::memory_order_seq_cst);
+    if (sleepers.load(std::memory_order_seq_cst) > 0) {
+      std::lock_guard<std::mutex> lk(sleep_mutex);
+      sleep_cv.notify_one();
+    }
+  }
+
+  void execute(Job *job, size_t slot) {
+    Counter *counter = job->counter;
+    job->invoke(job);
+    release_job(job, slot);
+    if (slot != NO_SLOT)
+      slots[slot]->executed.fetch_add(1, std::memory_order_relaxed);
+    if (counter)
+      finish(*counter);
+  }
+
+  void finish(Counter &counter) {
+    counter.finishing.fetch_add(1, std::memory_order_acq_rel);
+    if (counter.pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      std::vector<Job *> ready;
+      {
+        std::lock_guard<std::mutex> lk(counter.mutex);
+        ready.swap(counter.continuations);
+      }
+      for (Job *job : ready)
+        submit(job);
+    }
+    counter.finishing.fetch_sub(1, std::memory_order_release);
+  }
+
+  // Find one job (own deque, injection queue, then steal) and run it.
+  bool run_one(size_t slot) {
+    Job *job = nullptr;
+    if (slot != NO_SLOT)
+      job = slots[slot]->deque.pop();
+    if (!job)
+      job = take_injected();
+    if (!job) {
+      job = steal_from_others(slot);
+      if (job && slot != NO_SLOT)
+        slots[slot]->stolen.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (!job)
+      return false;
+    queued.fetch_sub(1, std::memory_order_relaxed);
+    execute(job, slot);
+    return true;
+  }
+
+  Job *take_injected() {
+    if (queued.load(std::memory_order_relaxed) <= 0)
+      return nullptr;
+    std::lock_guard<std::mutex> lk(injection_mutex);
+    if (injection.empty())
+      return nullptr;
+    Job *job = injection.back();
+    injection.pop_back();
+    return job;
+  }
+
+  Job *steal_from_others(size_t slot) {
+    const size_t n = slots.size();
+    size_t start = 0;
+    if (slot != NO_SLOT) {
+      uint32_t &x = slots[slot]->rng; // xorshift32
+      x ^= x << 13;
+      x ^= x >> 17;
+      x ^= x << 5;
+      start = x % n;
+    }
+    for (size_t i = 0; i < n; ++i) {
+      size_t victim = (start + i) % n;
+      if (victim == slot)
+        continue;
+      if (Job *job = slots[victim]->deque.steal())
+        return job;
+    }
+    return nullptr;
+  }
+
+  template <typename Func>
+  void spawn_range(size_t begin, size_t end, size_t chunk, Func &fn,
+                   Counter &counter) {
+    // keep the left part, hand the right halves out as jobs
+    while (end - begin > chunk) {
+      size_t mid = begin + (end - begin) / 2;
+      spawn([this, mid, end, chunk, &fn,
+             &counter] { spawn_range(mid, end, chunk, fn, counter); },
+            &counter);
+      end = mid;
+    }
+    fn(begin, end);
+  }
+
+  // -------------------------------------------
+  // Workers
+  // -------------------------------------------
+  size_t current_slot() const {
+    if (tls_system() == this)
+      return tls_slot();
+    return std::this_thread::get_id() == owner ? 0 : NO_SLOT;
+  }
+
+  static const JobSystem *&tls_system() {
+    thread_local const JobSystem *system = nullptr;
+    return system;
+  }
+
+  static size_t &tls_slot() {
+    thread_local size_t slot = NO_SLOT;
+    return slot;
+  }
+
+  void worker_loop(size_t slot) {
+    tls_system() = this;
+    tls_slot() = slot;
+    unsigned idle_rounds = 0;
+    while (true) {
+      if (run_one(slot)) {
+        idle_rounds = 0;
+        continue;
+      }
+      if (++idle_rounds < 64) {
+        std::this_thread::yield();
+        continue;
+      }
+      idle_rounds = 0;
+
+      std::unique_lock<std::mutex> lk(sleep_mutex);
+      sleepers.fetch_add(1, std::memory_order_seq_cst);
+      sleep_cv.wait(lk, [this] {
+        return stopping || queued.load(std::memory_order_seq_cst) > 0;
+      });
+      sleepers.fetch_sub(1, std::memory_order_seq_cst);
+      if (stopping)
+        return;
+    }
+  }
+
+  std::thread::id owner;
+  std::vector<std::unique_ptr<Slot>> slots;
+  std::vector<std::thread> workers;
+
+  // jobs pushed but not yet taken (drives sleeping)
+  std::atomic<int64_t> queued{0};
+  std::atomic<int> sleepers{0};
+  std::mutex sleep_mutex; // guards stopping, pairs with sleep_cv
+  std::condition_variable sleep_cv;
+  bool stopping = false;
+
+  std::mutex injection_mutex;
+  std::vector<Job *> injection; // submissions from foreign threads
+};
@@ -0,0 +1,296 @@
+#pragma once
+#include "ecs.h"
+#include "job_system.h"
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+//
+// System scheduler
+//
+// Design notes:
+// - A system is a callable fn(ECS&, float dt) plus the component types it
+//   reads and writes, declared as Reads<...> / Writes<...> tags. Types are
+//   recorded by ComponentFamily id, so declarations don't need a world.
+// - Two systems conflict when one writes a type the other reads or writes.
+//   Each system depends on every earlier-registered system it conflicts
+//   with, so the registration order is the order of conflicting systems
+//   and everything else is free to overlap.
+// - The dependency DAG covers the systems enabled for the frame. It is
+//   rebuilt at the start of run() whenever systems were added or toggled.
+// - Ready systems run as jobs on a JobSystem. Main-thread systems (render,
+//   anything touching the window/GL context) are queued for the thread that
+//   called run(), which executes them in between helping with jobs.
+// - Exclusive systems conflict with every other system and run on the main
+//   thread; they are the place for structural changes (create/destroy,
+//   add/remove) since nothing else touches the world meanwhile.
+// - Before dispatching, run() registers every declared component type in
+//   the world so concurrent systems never create storages.
+//
+// Per-system wall time of the last frame and the running total are kept
+// for profiling (see timings()). They are published when run() returns,
+// so a system may read timings() while others are still being timed.
+//
+// BasicScheduler<MaxComponents> drives a BasicECS<MaxComponents>;
+// Scheduler is the one for ECS.
+//
+
+template <typename... Ts> struct Reads {};
+template <typename... Ts> struct Writes {};
+
+template <size_t MaxComponents> class BasicScheduler {
+  using World = BasicECS<MaxComponents>;
+
+public:
+  using SystemFn = std::function<void(World &, float)>;
+  using SystemId = size_t;
+
+  // Wall time of one system
+  struct Timing {
+    const std::string *name;
+    double last_ms;  // last frame it ran in
+    double total_ms; // accumulated over all frames
+    uint64_t runs;
+  };
+
+  // -------------------------------------------
+  // Registration
+  // -------------------------------------------
+  // System that may run on any job system thread.
+  template <typename... R, typename... W>
+  SystemId add(std::string name, Reads<R...>, Writes<W...>, SystemFn fn) {
+    return add_system<R...>(std::move(name), Writes<W...>{}, std::move(fn),
+                            false, false);
+  }
+
+  // System that must run on the thread calling run().
+  template <typename... R, typename... W>
+  SystemId add_main(std::string name, Reads<R...>, Writes<W...>, SystemFn fn) {
+    return add_system<R...>(std::move(name), Writes<W...>{}, std::move(fn),
+                            true, false);
+  }
+
+  // System that runs alone, on the thread calling run().
+  SystemId add_exclusive(std::string name, SystemFn fn) {
+    return add_system<>(std::move(name), Writes<>{}, std::move(fn), true,
+                        true);
+  }
+
+  void set_enabled(SystemId id, bool enabled) {
+    if (systems[id].enabled != enabled) {
+      systems[id].enabled = enabled;
+      dirty = true;
+    }
+  }
+
+  size_t size() const { return systems.size(); }
+
+  // True if `after` waits for `before` in the current graph.
+  bool depends_on(SystemId after, SystemId before) {
+    rebuild_if_dirty();
+    for (size_t dep : systems[before].successors)
+      if (dep == after)
+        return true;
+    return false;
+  }
+
+  // -------------------------------------------
+  // Execution
+  // -------------------------------------------
+  // Run one frame: every enabled system exactly once, respecting the
+  // dependency graph. Returns when all of them finished.
+  void run(World &ecs, float dt, JobSystem &jobs) {
+    rebuild_if_dirty();
+    for (auto &prepare : preparers)
+      prepare(ecs);
+    if (order.empty())
+      return;
+
+    Frame frame{ecs, dt, jobs};
+    frame.remaining = std::vector<std::atomic<int>>(systems.size());
+    for (SystemId id : order)
+      frame.remaining[id].store(systems[id].predecessors,
+                                std::memory_order_relaxed);
+    for (SystemId id : order)
+      if (systems[id].predecessors == 0)
+        dispatch(frame, id);
+
+    // main-thread loop: run queued main systems, help with jobs otherwise
+    while (frame.completed.load(std::memory_order_acquire) != order.size()) {
+      SystemId id;
+      if (pop_main(frame, id)) {
+        execute(frame, id);
+        continue;
+      }
+      jobs.wait_until([&frame, this] {
+        return frame.completed.load(std::memory_order_acquire) ==
+                   order.size() ||
+               frame.main_ready.load(std::memory_order_acquire) > 0;
+      });
+    }
+    // jobs may still be leaving execute(); frame must outlive them
+    jobs.wait(frame.jobs_counter);
+
+    // sync point: nothing runs, so the frame's times can be published
+    for (SystemId id : order) {
+      System &s = systems[id];
+      s.last_ms = s.frame_ms;
+      s.total_ms += s.frame_ms;
+      s.runs++;
+    }
+  }
+
+  void run(World &ecs, float dt) { run(ecs, dt, JobSystem::global()); }
+
+  // Times of the last completed run(); during a run, those of the frame
+  // before.
+  std::vector<Timing> timings() const {
+    std::vector<Timing> out;
+    out.reserve(systems.size());
+    for (auto &s : systems)
+      out.push_back({&s.name, s.last_ms, s.total_ms, s.runs});
+    return out;
+  }
+
+private:
+  struct System {
+    std::string name;
+    SystemFn fn;
+    std::vector<size_t> reads;  // family ids
+    std::vector<size_t> writes; // family ids
+    bool main_thread = false;
+    bool exclusive = false;
+    bool enabled = true;
+
+    // graph over enabled systems
+    std::vector<SystemId> successors;
+    int predecessors = 0;
+
+    double frame_ms = 0; // written by execute(), during run()
+    double last_ms = 0;  // published by run() at its end
+    double total_ms = 0;
+    uint64_t runs = 0;
+  };
+
+  // State shared by the jobs of one run() call
+  struct Frame {
+    Frame(World &ecs, float dt, JobSystem &jobs)
+        : ecs(ecs), dt(dt), jobs(jobs) {}
+    World &ecs;
+    float dt;
+    JobSystem &jobs;
+    std::vector<std::atomic<int>> remaining; // unfinished predecessors
+    std::atomic<size_t> completed{0};
+    JobSystem::Counter jobs_counter;
+
+    std::mutex main_mutex; // guards main_queue
+    std::vector<SystemId> main_queue;
+    std::atomic<size_t> main_ready{0};
+  };
+
+  template <typename... R, typename... W>
+  SystemId add_system(std::string name, Writes<W...>, SystemFn fn,
+                      bool main_thread, bool exclusive) {
+    System s;
+    s.name = std::move(name);
+    s.fn = std::move(fn);
+    s.reads = {ComponentFamily::id<R>()...};
+    s.writes = {ComponentFamily::id<W>()...};
+    s.main_thread = main_thread;
+    s.exclusive = exclusive;
+    systems.push_back(std::move(s));
+    if (sizeof...(R) + sizeof...(W) > 0)
+      preparers.push_back([](World &ecs) {
+        (void)std::initializer_list<int>{
+            (ecs.template component_id<R>(), 0)...,
+            (ecs.template component_id<W>(), 0)...};
+      });
+    dirty = true;
+    return systems.size() - 1;
+  }
+
+  static bool overlaps(const std::vector<size_t> &a,
+                       const std::vector<size_t> &b) {
+    for (size_t x : a)
+      for (size_t y : b)
+        if (x == y)
+          return true;
+    return false;
+  }
+
+  static bool conflicts(const System &a, const System &b) {
+    if (a.exclusive || b.exclusive)
+      return true;
+    return overlaps(a.writes, b.writes) || overlaps(a.writes, b.reads) ||
+           overlaps(a.reads, b.writes);
+  }
+
+  void rebuild_if_dirty() {
+    if (!dirty)
+      return;
+    dirty = false;
+    order.clear();
+    for (auto &s : systems) {
+      s.successors.clear();
+      s.predecessors = 0;
+    }
+    for (SystemId i = 0; i < systems.size(); ++i) {
+      if (!systems[i].enabled)
+        continue;
+      for (SystemId before : order)
+        if (conflicts(systems[before], systems[i])) {
+          systems[before].successors.push_back(i);
+          systems[i].predecessors++;
+        }
+      order.push_back(i);
+    }
+  }
+
+  void dispatch(Frame &frame, SystemId id) {
+    if (systems[id].main_thread) {
+      std::lock_guard<std::mutex> lk(frame.main_mutex);
+      frame.main_queue.push_back(id);
+      frame.main_ready.fetch_add(1, std::memory_order_release);
+      return;
+    }
+    frame.jobs.spawn([this, &frame, id] { execute(frame, id); },
+                     &frame.jobs_counter);
+  }
+
+  bool pop_main(Frame &frame, SystemId &id) {
+    if (frame.main_ready.load(std::memory_order_acquire) == 0)
+      return false;
+    std::lock_guard<std::mutex> lk(frame.main_mutex);
+    id = frame.main_queue.back();
+    frame.main_queue.pop_back();
+    frame.main_ready.fetch_sub(1, std::memory_order_release);
+    return true;
+  }
+
+  void execute(Frame &frame, SystemId id) {
+    System &s = systems[id];
+    auto start = std::chrono::steady_clock::now();
+    s.fn(frame.ecs, frame.dt);
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    s.frame_ms = elapsed.count();
+
+    for (SystemId next : s.successors)
+      if (frame.remaining[next].fetch_sub(1, std::memory_order_acq_rel) == 1)
+        dispatch(frame, next);
+    frame.completed.fetch_add(1, std::memory_order_acq_rel);
+  }
+
+  std::vector<System> systems;
+  // one callback per system that registers its component types in a world
+  std::vector<std::function<void(World &)>> preparers;
+  std::vector<SystemId> order; // enabled systems, registration order
+  bool dirty = true;
+};
+
+using Scheduler = BasicScheduler<0>;
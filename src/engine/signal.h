@@ -0,0 +1,115 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+//
+// Delegates and signals
+//
+// Design notes:
+// - Delegate<R(Args...)> is two words: a plain function pointer and the
+//   instance it is bound to. Binding never allocates; the target function
+//   is a template argument baked into a small trampoline.
+// - Three ways to bind: a free function (connect<&fn>()), a member function
+//   on an instance (connect<&C::fn>(c)), or a callable object kept by
+//   reference (connect(obj)). The caller keeps instances alive.
+// - Signal<void(Args...)> is a vector of delegates called in connection
+//   order. An empty signal costs one size check at the call site.
+// - Delegates compare equal when they call the same trampoline on the same
+//   instance, which is what disconnect() matches.
+//
+template <typename Sig> class Delegate;
+
+template <typename R, typename... Args> class Delegate<R(Args...)> {
+public:
+  Delegate() = default;
+
+  template <auto Fn> void connect() {
+    instance = nullptr;
+    call = [](void *, Args... args) -> R {
+      return Fn(std::forward<Args>(args)...);
+    };
+  }
+
+  template <auto Fn, typename C> void connect(C &obj) {
+    instance = &obj;
+    call = [](void *self, Args... args) -> R {
+      return (static_cast<C *>(self)->*Fn)(std::forward<Args>(args)...);
+    };
+  }
+
+  template <typename F> void connect(F &fn) {
+    instance = &fn;
+    call = [](void *self, Args... args) -> R {
+      return (*static_cast<F *>(self))(std::forward<Args>(args)...);
+    };
+  }
+
+  void reset() {
+    instance = nullptr;
+    call = nullptr;
+  }
+
+  explicit operator bool() const { return call != nullptr; }
+
+  R operator()(Args... args) const {
+    return call(instance, std::forward<Args>(args)...);
+  }
+
+  bool operator==(const Delegate &other) const {
+    return call == other.call && instance == other.instance;
+  }
+  bool operator!=(const Delegate &other) const { return !(*this == other); }
+
+private:
+  void *instance = nullptr;
+  R (*call)(void *, Args...) = nullptr;
+};
+
+template <typename Sig> class Signal;
+
+template <typename... Args> class Signal<void(Args...)> {
+public:
+  using Slot = Delegate<void(Args...)>;
+
+  template <auto Fn> void connect() { add(make<Fn>()); }
+  template <auto Fn, typename C> void connect(C &obj) { add(make<Fn>(obj)); }
+  template <typename F> void connect(F &fn) { add(make(fn)); }
+
+  template <auto Fn> void disconnect() { remove(make<Fn>()); }
+  template <auto Fn, typename C> void disconnect(C &obj) {
+    remove(make<Fn>(obj));
+  }
+  template <typename F> void disconnect(F &fn) { remove(make(fn)); }
+
+  void clear() { slots.clear(); }
+  bool empty() const { return slots.empty(); }
+  size_t size() const { return slots.size(); }
+
+  // Call every slot in connection order. Slots must not connect to or
+  // disconnect from this signal while it is being published.
+  void publish(Args... args) const {
+    for (const Slot &slot : slots)
+      slot(args...);
+  }
+
+private:
+  template <auto Fn, typename... C> static Slot make(C &...obj) {
+    Slot slot;
+    slot.template connect<Fn>(obj...);
+    return slot;
+  }
+  template <typename F> static Slot make(F &fn) {
+    Slot slot;
+    slot.connect(fn);
+    return slot;
+  }
+
+  void add(const Slot &slot) { slots.push_back(slot); }
+  void remove(const Slot &slot) {
+    slots.erase(std::remove(slots.begin(), slots.end(), slot), slots.end());
+  }
+
+  std::vector<Slot> slots;
+};
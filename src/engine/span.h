@@ -0,0 +1,52 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+// -------------------------------------------------------------
+// Span<T>: non-owning view of a contiguous range (C++17 stand-in for
+// std::span). Span<const T> binds to const and non-const vectors alike.
+// -------------------------------------------------------------
+template <typename T> class Span {
+public:
+  using value_type = std::remove_cv_t<T>;
+
+  constexpr Span() = default;
+  constexpr Span(T *data, size_t size) : ptr(data), count(size) {}
+
+  template <typename U, typename = std::enable_if_t<
+                            std::is_convertible_v<U (*)[], T (*)[]>>>
+  Span(std::vector<U> &v) : ptr(v.data()), count(v.size()) {}
+
+  template <typename U, typename = std::enable_if_t<
+                            std::is_convertible_v<const U (*)[], T (*)[]>>>
+  Span(const std::vector<U> &v) : ptr(v.data()), count(v.size()) {}
+
+  // Span<T> -> Span<const T>
+  template <typename U, typename = std::enable_if_t<
+                            std::is_convertible_v<U (*)[], T (*)[]>>>
+  constexpr Span(const Span<U> &other)
+      : ptr(other.data()), count(other.size()) {}
+
+  constexpr T *data() const { return ptr; }
+  constexpr size_t size() const { return count; }
+  constexpr bool empty() const { return count == 0; }
+
+  constexpr T *begin() const { return ptr; }
+  constexpr T *end() const { return ptr + count; }
+
+  T &operator[](size_t i) const {
+    assert(i < count);
+    return ptr[i];
+  }
+
+  Span subspan(size_t offset, size_t n) const {
+    assert(offset + n <= count);
+    return Span(ptr + offset, n);
+  }
+
+private:
+  T *ptr = nullptr;
+  size_t count = 0;
+};
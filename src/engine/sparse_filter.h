@@ -0,0 +1,271 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// GCC/Clang on x86-64 build every kernel (target attributes) and pick one
+// at runtime; other compilers get the widest one the build targets.
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__) &&      \
+    !defined(__EMSCRIPTEN__)
+#define RECS_SPARSE_DISPATCH 1
+#define RECS_TARGET_AVX2 __attribute__((target("avx2")))
+#define RECS_TARGET_AVX512 __attribute__((target("avx2,avx512f,avx512vl")))
+#include <immintrin.h>
+#else
+#define RECS_TARGET_AVX2
+#define RECS_TARGET_AVX512
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#endif
+
+//
+// Vectorized sparse set lookups
+//
+// Bulk versions of EntitySet<uint32_t>::contains / index_of over a run of
+// entity ids. A lookup is two gathers: the page pointer of every id, then
+// the sparse slot inside that page; a third gather of the dense entity at
+// that slot confirms membership, as contains() does. Ids past the page
+// table or on an unallocated page come out as absent without touching
+// memory. lookup_many() writes the dense index of every id (INVALID when
+// absent); filter_present() keeps the ids that are present and may write
+// scratch values past them, so its output needs room for n ids.
+//
+// Kernels: AVX-512 (8 ids per step), AVX2 (4) and scalar. Unlike
+// mask_filter.h, the choice is made at runtime from cpuid where the
+// compiler supports target attributes: the release build does not pass
+// -mavx2, and the gathers here are worth more than mask_filter's
+// loads. A build that already targets AVX-512 skips the check.
+//
+namespace sparse_filter {
+
+// Paged sparse table + dense entity list of an EntitySet<uint32_t>.
+struct Table {
+  const uint32_t *const *pages; // pages[id >> PAGE_BITS], may be null
+  size_t page_count;
+  const uint32_t *dense;
+  static constexpr uint32_t PAGE_BITS = 11;
+  static constexpr uint32_t PAGE_MASK = (1u << PAGE_BITS) - 1;
+  static constexpr uint32_t INVALID = 0xFFFFFFFFu;
+};
+
+// Dense index of id, or INVALID.
+inline uint32_t lookup_one(const Table &t, uint32_t id) {
+  const size_t page = id >> Table::PAGE_BITS;
+  if (page >= t.page_count || !t.pages[page])
+    return Table::INVALID;
+  const uint32_t idx = t.pages[page][id & Table::PAGE_MASK];
+  return idx != Table::INVALID && t.dense[idx] == id ? idx : Table::INVALID;
+}
+
+inline void lookup_scalar(const Table &t, const uint32_t *ids, size_t from,
+                          size_t n, uint32_t *out) {
+  for (size_t i = from; i < n; ++i)
+    out[i] = lookup_one(t, ids[i]);
+}
+
+inline size_t filter_scalar(const Table &t, const uint32_t *ids, size_t from,
+                            size_t n, uint32_t *out) {
+  size_t count = 0;
+  for (size_t i = from; i < n; ++i)
+    if (lookup_one(t, ids[i]) != Table::INVALID)
+      out[count++] = ids[i];
+  return count;
+}
+
+#if defined(RECS_SPARSE_DISPATCH) ||                                         \
+    (defined(__AVX512F__) && defined(__AVX512VL__))
+#define RECS_SPARSE_AVX512 1
+// 8 ids per step; returns their dense indices, INVALID where absent.
+RECS_TARGET_AVX512 inline __m256i lookup8(const Table &t, __m256i ids) {
+  const __m256i invalid = _mm256_set1_epi32(-1);
+  const __m256i page = _mm256_srli_epi32(ids, Table::PAGE_BITS);
+  __mmask8 ok = _mm256_cmplt_epu32_mask(
+      page, _mm256_set1_epi32(static_cast<int>(t.page_count)));
+  const __m512i ptrs = _mm512_mask_i32gather_epi64(
+      _mm512_setzero_si512(), ok, page, t.pages, 8);
+  ok &= _mm512_test_epi64_mask(ptrs, ptrs);
+  // byte offset of the slot (< 8 KiB, so shifted while still 32-bit);
+  // maskz widening: the unmasked form trips -Wmaybe-uninitialized in GCC
+  const __m512i offs = _mm512_maskz_cvtepu32_epi64(
+      0xFF, _mm256_slli_epi32(
+                _mm256_and_si256(ids, _mm256_set1_epi32(Table::PAGE_MASK)),
+                2));
+  const __m256i idx = _mm512_mask_i64gather_epi32(
+      invalid, ok, _mm512_add_epi64(ptrs, offs), nullptr, 1);
+  ok &= _mm256_cmpneq_epi32_mask(idx, invalid);
+  const __m256i owner =
+      _mm256_mmask_i32gather_epi32(invalid, ok, idx, t.dense, 4);
+  ok &= _mm256_cmpeq_epi32_mask(owner, ids);
+  return _mm256_mask_blend_epi32(ok, invalid, idx);
+}
+
+RECS_TARGET_AVX512 inline void lookup_many_avx512(const Table &t,
+                                                 const uint32_t *ids,
+                                                 size_t n, uint32_t *out) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i *>(out + i),
+        lookup8(t, _mm256_loadu_si256(
+                       reinterpret_cast<const __m256i *>(ids + i))));
+  lookup_scalar(t, ids, i, n, out);
+}
+
+RECS_TARGET_AVX512 inline size_t filter_present_avx512(const Table &t,
+                                                      const uint32_t *ids,
+                                                      size_t n,
+                                                      uint32_t *out) {
+  size_t count = 0;
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ids + i));
+    const __mmask8 hit =
+        _mm256_cmpneq_epi32_mask(lookup8(t, v), _mm256_set1_epi32(-1));
+    _mm256_mask_compressstoreu_epi32(out + count, hit, v);
+    for (unsigned m = hit; m; m &= m - 1)
+      ++count;
+  }
+  return count + filter_scalar(t, ids, i, n, out + count);
+}
+#endif
+
+#if defined(RECS_SPARSE_DISPATCH) || defined(__AVX2__)
+#define RECS_SPARSE_AVX2 1
+// compact_table.masks[hit]: byte shuffle that moves the 32-bit lanes set
+// in hit (4 bits) to the front.
+struct CompactTable {
+  alignas(16) uint8_t masks[16][16];
+  constexpr CompactTable() : masks() {
+    for (unsigned hit = 0; hit < 16; ++hit) {
+      unsigned to = 0;
+      for (unsigned lane = 0; lane < 4; ++lane)
+        if (hit >> lane & 1) {
+          for (unsigned b = 0; b < 4; ++b)
+            masks[hit][to * 4 + b] = static_cast<uint8_t>(lane * 4 + b);
+          ++to;
+        }
+      for (; to < 4; ++to)
+        for (unsigned b = 0; b < 4; ++b)
+          masks[hit][to * 4 + b] = 0x80;
+    }
+  }
+};
+inline constexpr CompactTable compact_table{};
+
+// 4 ids per step (the page pointers fill a 256-bit register).
+RECS_TARGET_AVX2 inline __m128i lookup4(const Table &t, __m128i ids) {
+  const __m128i invalid = _mm_set1_epi32(-1);
+  const __m128i page = _mm_srli_epi32(ids, Table::PAGE_BITS);
+  // page < page_count; both fit in 21 bits, so a signed compare works
+  __m128i ok = _mm_cmplt_epi32(
+      page, _mm_set1_epi32(static_cast<int>(t.page_count)));
+  const __m256i ptrs = _mm256_mask_i32gather_epi64(
+      _mm256_setzero_si256(), reinterpret_cast<const long long *>(t.pages),
+      page, _mm256_cvtepi32_epi64(ok), 8);
+  const __m256i null64 = _mm256_cmpeq_epi64(ptrs, _mm256_setzero_si256());
+  // narrow the 64-bit "null" lanes to 32 bits (even dwords)
+  const __m128i null32 = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(
+      null64, _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6)));
+  ok = _mm_andnot_si128(null32, ok);
+  const __m128i slot = _mm_and_si128(ids, _mm_set1_epi32(Table::PAGE_MASK));
+  const __m256i offs = _mm256_slli_epi64(_mm256_cvtepu32_epi64(slot), 2);
+  const __m128i idx = _mm256_mask_i64gather_epi32(
+      invalid, nullptr, _mm256_add_epi64(ptrs, offs), ok, 1);
+  ok = _mm_andnot_si128(_mm_cmpeq_epi32(idx, invalid), ok);
+  const __m128i owner = _mm_mask_i32gather_epi32(
+      invalid, reinterpret_cast<const int *>(t.dense), idx, ok, 4);
+  ok = _mm_and_si128(ok, _mm_cmpeq_epi32(owner, ids));
+  return _mm_blendv_epi8(invalid, idx, ok);
+}
+
+RECS_TARGET_AVX2 inline void lookup_many_avx2(const Table &t,
+                                             const uint32_t *ids, size_t n,
+                                             uint32_t *out) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(ids + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), lookup4(t, v));
+  }
+  lookup_scalar(t, ids, i, n, out);
+}
+
+RECS_TARGET_AVX2 inline size_t filter_present_avx2(const Table &t,
+                                                  const uint32_t *ids,
+                                                  size_t n, uint32_t *out) {
+  size_t count = 0;
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(ids + i));
+    const __m128i absent = _mm_cmpeq_epi32(lookup4(t, v), _mm_set1_epi32(-1));
+    const unsigned miss =
+        static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(absent)));
+    // pack the hits to the front and store all 4 lanes; only the first
+    // popcount(hit) are kept (out[count + 3] is at most ids + i + 3)
+    const unsigned hit = ~miss & 0xF;
+    const __m128i pack = _mm_load_si128(
+        reinterpret_cast<const __m128i *>(compact_table.masks[hit]));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + count),
+                     _mm_shuffle_epi8(v, pack));
+    count += (0x4332322132212110ull >> (hit * 4)) & 0xF; // popcount
+  }
+  return count + filter_scalar(t, ids, i, n, out + count);
+}
+#endif
+
+enum class Kernel { SCALAR, AVX2, AVX512 };
+
+// Widest kernel this CPU (and OS) runs; checked once.
+inline Kernel kernel() {
+#if defined(__AVX512F__) && defined(__AVX512VL__)
+  return Kernel::AVX512;
+#elif defined(RECS_SPARSE_DISPATCH)
+  static const Kernel best = [] {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl"))
+      return Kernel::AVX512;
+    if (__builtin_cpu_supports("avx2"))
+      return Kernel::AVX2;
+    return Kernel::SCALAR;
+  }();
+  return best;
+#elif defined(__AVX2__)
+  return Kernel::AVX2;
+#else
+  return Kernel::SCALAR;
+#endif
+}
+
+// out[i] = dense index of ids[i], or INVALID.
+inline void lookup_many(const Table &t, const uint32_t *ids, size_t n,
+                        uint32_t *out, Kernel k = kernel()) {
+#ifdef RECS_SPARSE_AVX512
+  if (k == Kernel::AVX512)
+    return lookup_many_avx512(t, ids, n, out);
+#endif
+#ifdef RECS_SPARSE_AVX2
+  if (k != Kernel::SCALAR)
+    return lookup_many_avx2(t, ids, n, out);
+#endif
+  (void)k;
+  lookup_scalar(t, ids, 0, n, out);
+}
+
+// Copy the present ids to out, in order; returns how many.
+inline size_t filter_present(const Table &t, const uint32_t *ids, size_t n,
+                             uint32_t *out, Kernel k = kernel()) {
+#ifdef RECS_SPARSE_AVX512
+  if (k == Kernel::AVX512)
+    return filter_present_avx512(t, ids, n, out);
+#endif
+#ifdef RECS_SPARSE_AVX2
+  if (k != Kernel::SCALAR)
+    return filter_present_avx2(t, ids, n, out);
+#endif
+  (void)k;
+  return filter_scalar(t, ids, 0, n, out);
+}
+
+} // namespace sparse_filter
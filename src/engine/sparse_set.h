@@ -1,10 +1,29 @@
 #pragma once
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <cstdlib>
+#include <new>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "sparse_filter.h"
+#include "span.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
+
+// MappedEntitySet needs lazily committed anonymous mappings and a 64-bit
+// address space.
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(__EMSCRIPTEN__) &&  \
+    UINTPTR_MAX > 0xFFFFFFFFu
+#define RECS_MAPPED_SPARSE 1
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 /**
  * ======================================================================
  * SparseSet<Entity, T>
@@ -43,25 +62,131 @@
  * Paged sparse storage avoids allocating a 2-GB sparse array for worlds
  * with large random entity IDs. Only touched pages are allocated.
  *
+ * The sparse table and the dense entity list live in EntitySet<Entity>,
+ * which is usable on its own when only membership and a packed entity list
+ * are needed (e.g. group match lists). SparseSet<T> adds the component
+ * array on top and keeps it in step with the dense entity list.
+ *
+ * PagedSet<T> keeps the components in fixed-size pages instead, for
+ * storages that must grow without moving anything (see ComponentTraits).
+ *
+ * Each sparse page counts its live entries. A page whose last entry is
+ * erased is released right away, either to a SparsePagePool shared by
+ * several sets (use_pool()) or back to malloc.
+ *
+ * MappedEntitySet is an alternate sparse table for very large or very
+ * scattered entity ids: one flat virtual range the kernel fills with
+ * zero pages on first touch. SparseSet takes it as its Index parameter.
+ *
+ * get_batch() / contains_batch() look up many entities at once and
+ * prefetch the sparse slot and component of the entries a few steps
+ * ahead, so the cache misses of a random batch overlap instead of running
+ * one after another.
+ *
+ * contains_many() / index_of_many() / filter() answer the same question
+ * for a run of ids with SIMD gathers (sparse_filter.h) when Entity is
+ * 32 bits wide.
+ *
+ * ======================================================================
+ */
+
+// Hint the cache to load p; a no-op where no builtin is available.
+inline void sparse_prefetch(const void *p) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  _mm_prefetch(static_cast<const char *>(p), _MM_HINT_T0);
+#elif defined(__GNUC__) || defined(__clang__)
+  __builtin_prefetch(p);
+#else
+  (void)p;
+#endif
+}
+
+/**
+ * ======================================================================
+ * SparsePagePool<Entity>
+ * ======================================================================
+ *
+ * Free list of sparse pages shared by the sets of one world. Pages come
+ * back with every entry INVALID (that is why they were released), so
+ * handing one out again skips the fill loop. Not thread-safe: sets using
+ * a pool must not change membership concurrently.
+ *
  * ======================================================================
  */
-template <typename T, typename Entity = uint32_t> class SparseSet {
+template <typename Entity = uint32_t> class SparsePagePool {
 public:
-  static_assert(
-      !std::is_void_v<T>,
-      "SparseSet<T=void> is not allowed. Use a tag component instead.");
+  static constexpr size_t PAGE_BYTES = sizeof(Entity) * (size_t(1) << 11);
+
+  SparsePagePool() = default;
+  SparsePagePool(const SparsePagePool &) = delete;
+  SparsePagePool &operator=(const SparsePagePool &) = delete;
+  ~SparsePagePool() { trim(); }
+
+  // A page with every entry INVALID, or nullptr if the pool is empty.
+  Entity *acquire() {
+    if (free_pages.empty())
+      return nullptr;
+    Entity *page = free_pages.back();
+    free_pages.pop_back();
+    return page;
+  }
+
+  // Take back a page whose entries are all INVALID.
+  void release(Entity *page) { free_pages.push_back(page); }
+
+  // Return every pooled page to malloc.
+  size_t trim() {
+    const size_t bytes = pooled_bytes();
+    for (Entity *page : free_pages)
+      std::free(page);
+    free_pages.clear();
+    free_pages.shrink_to_fit();
+    return bytes;
+  }
+
+  size_t pooled_bytes() const { return free_pages.size() * PAGE_BYTES; }
+
+private:
+  std::vector<Entity *> free_pages;
+};
 
+/**
+ * ======================================================================
+ * EntitySet<Entity>
+ * ======================================================================
+ *
+ * Sparse set without payload: paged sparse table + packed entity list.
+ * Same O(1) insert / contains / erase (swap with last) as SparseSet.
+ *
+ * ======================================================================
+ */
+template <typename Entity = uint32_t> class EntitySet {
+public:
   // Value stored in sparse table when element is not present.
   static constexpr Entity INVALID = static_cast<Entity>(-1);
 
-  SparseSet() = default;
+  // Dense entry left by erase_in_place() until insert_at() refills it.
+  static constexpr Entity TOMBSTONE = INVALID;
+
+  EntitySet() = default;
 
-  // Frees all sparse pages on destruction.
-  ~SparseSet() {
+  // Frees all sparse pages on destruction (straight to malloc: pages
+  // with live entries would need a reset before they could be pooled).
+  ~EntitySet() {
     for (auto *p : pages)
       std::free(p);
   }
 
+  /**
+   * Get fresh sparse pages from (and release empty ones to) `shared`
+   * instead of malloc/free. Set it before the first insert; the pool must
+   * outlive the set.
+   */
+  void use_pool(SparsePagePool<Entity> *shared) {
+    assert(pages.empty());
+    pool = shared;
+  }
+
   // --------------------------------------------------------------------
   // Paging constants (Sparse array paging)
   // --------------------------------------------------------------------
@@ -83,15 +208,39 @@ private:
     if (page_idx >= pages.size())
       pages.resize(page_idx + 1, nullptr);
 
+    if (page_idx >= page_live.size())
+      page_live.resize(pages.size(), 0);
+
     if (!pages[page_idx]) {
-      Entity *page =
-          (Entity *)std::malloc(sizeof(Entity) * SPARSE_SET_PAGE_SIZE);
-      for (size_t i = 0; i < SPARSE_SET_PAGE_SIZE; i++)
-        page[i] = INVALID;
+      Entity *page = pool ? pool->acquire() : nullptr;
+      if (!page) {
+        page = (Entity *)std::malloc(sizeof(Entity) * SPARSE_SET_PAGE_SIZE);
+        for (size_t i = 0; i < SPARSE_SET_PAGE_SIZE; i++)
+          page[i] = INVALID;
+      }
       pages[page_idx] = page;
     }
   }
 
+  void free_page(Entity *page) {
+    if (pool)
+      pool->release(page);
+    else
+      std::free(page);
+  }
+
+  // Clear sparse[e] of an entity being erased; releases its page once the
+  // last live entry on it is gone.
+  void clear_slot(Entity e) {
+    const size_t page_idx = e >> SPARSE_SET_PAGE_BITS;
+    pages[page_idx][e & SPARSE_SET_PAGE_MASK] = INVALID;
+    if (--page_live[page_idx] == 0) {
+      free_page(pages[page_idx]);
+      pages[page_idx] = nullptr;
+      reclaimed += PAGE_BYTES;
+    }
+  }
+
   /**
    * Returns a mutable reference to sparse[e],
    * allocating the page if necessary.
@@ -137,6 +286,632 @@ public:
     return idx != INVALID && dense_entities[idx] == e;
   }
 
+  /**
+   * Append entity e (must not be present) and return its dense index.
+   * Complexity: O(1)
+   */
+  size_t insert(Entity e) {
+    assert(!contains(e));
+    Entity &slot = sparse_ref(e);
+    slot = static_cast<Entity>(dense_entities.size());
+    page_live[e >> SPARSE_SET_PAGE_BITS]++;
+    dense_entities.push_back(e);
+    return dense_entities.size() - 1;
+  }
+
+  /**
+   * Reserve dense room for the n entities in ents and allocate the sparse
+   * pages they land on (only those), so a following run of insert() calls
+   * for them never reallocates or allocates pages.
+   */
+  void reserve(const Entity *ents, size_t n) {
+    if (n == 0)
+      return;
+    dense_entities.reserve(dense_entities.size() + n);
+    const size_t last_page =
+        size_t(*std::max_element(ents, ents + n)) >> SPARSE_SET_PAGE_BITS;
+    if (last_page >= pages.size()) {
+      pages.resize(last_page + 1, nullptr);
+      page_live.resize(pages.size(), 0);
+    }
+    for (size_t i = 0; i < n; i++)
+      if (!pages[ents[i] >> SPARSE_SET_PAGE_BITS])
+        ensure_page(ents[i] >> SPARSE_SET_PAGE_BITS);
+  }
+
+  /**
+   * Append n entities, none of which may be present yet. An entity listed
+   * more than once is added once. Pages and dense room are reserved once.
+   * Complexity: O(n)
+   */
+  void insert_bulk(const Entity *ents, size_t n) {
+    reserve(ents, n);
+    for (size_t i = 0; i < n; i++) {
+      const size_t page_idx = ents[i] >> SPARSE_SET_PAGE_BITS;
+      Entity &slot = pages[page_idx][ents[i] & SPARSE_SET_PAGE_MASK];
+      if (slot != INVALID) {
+        // repeated earlier in this batch
+        assert(dense_entities[slot] == ents[i]);
+        continue;
+      }
+      slot = static_cast<Entity>(dense_entities.size());
+      page_live[page_idx]++;
+      dense_entities.push_back(ents[i]);
+    }
+  }
+
+  /**
+   * Erase entity e (must be present) by moving the last entity into its
+   * slot. Returns the dense index that was vacated and refilled.
+   *
+   * Complexity: O(1)
+   */
+  size_t erase(Entity e) {
+    assert(contains(e));
+    Entity idx = sparse_ref(e);
+    Entity last_idx = static_cast<Entity>(dense_entities.size() - 1);
+    Entity last_entity = dense_entities[last_idx];
+
+    // Move last into removed slot
+    dense_entities[idx] = last_entity;
+
+    // Update sparse entry for swapped element
+    sparse_ref(last_entity) = idx;
+
+    // Remove last
+    dense_entities.pop_back();
+
+    // Invalidate removed sparse entry
+    clear_slot(e);
+    return idx;
+  }
+
+  /**
+   * Erase entity e (must be present) without moving any other entity: its
+   * dense slot becomes TOMBSTONE. Returns that slot.
+   * Complexity: O(1)
+   */
+  size_t erase_in_place(Entity e) {
+    assert(contains(e));
+    const size_t idx = index_of(e);
+    dense_entities[idx] = TOMBSTONE;
+    clear_slot(e);
+    return idx;
+  }
+
+  /**
+   * Put entity e (must not be present) into the TOMBSTONE slot idx.
+   * Complexity: O(1)
+   */
+  void insert_at(Entity e, size_t idx) {
+    assert(!contains(e) && dense_entities[idx] == TOMBSTONE);
+    sparse_ref(e) = static_cast<Entity>(idx);
+    page_live[e >> SPARSE_SET_PAGE_BITS]++;
+    dense_entities[idx] = e;
+  }
+
+  /**
+   * Dense index of an entity known to be present (no checks).
+   * Used by hot loops that already validated membership.
+   * Complexity: O(1)
+   */
+  Entity index_of(Entity e) const {
+    return pages[e >> SPARSE_SET_PAGE_BITS][e & SPARSE_SET_PAGE_MASK];
+  }
+
+  // Lookups run this many entries behind the prefetch of their payload,
+  // and twice as many behind the prefetch of their sparse slot.
+  static constexpr size_t BATCH_AHEAD = 8;
+
+  /**
+   * Batched lookup: calls fn(i, dense index of ents[i], or INVALID if it
+   * is not present) for every i in order. The sparse slot of ents[i] is
+   * prefetched 2 * BATCH_AHEAD entries early, and BATCH_AHEAD entries
+   * early touch(dense index) lets the caller prefetch the payload.
+   *
+   * Every erase resets its sparse slot, so a slot that is not INVALID
+   * belongs to a present entity: unlike contains(), the batch skips the
+   * dense entity check and its extra cache miss.
+   * Complexity: O(n)
+   */
+  template <typename Touch, typename Fn>
+  void lookup_batch(Span<const Entity> ents, Touch &&touch, Fn &&fn) const {
+    const size_t n = ents.size();
+    for (size_t i = 0; i < n; i++) {
+      if (i + 2 * BATCH_AHEAD < n)
+        if (const Entity *slot = sparse_ptr(ents[i + 2 * BATCH_AHEAD]))
+          sparse_prefetch(slot);
+      if (i + BATCH_AHEAD < n)
+        if (const Entity *slot = sparse_ptr(ents[i + BATCH_AHEAD]))
+          if (*slot != INVALID)
+            touch(*slot);
+      const Entity *slot = sparse_ptr(ents[i]);
+      fn(i, slot ? *slot : INVALID);
+    }
+  }
+
+  // out[i] = contains(ents[i]), with the prefetching of lookup_batch.
+  void contains_batch(Span<const Entity> ents, bool *out) const {
+    lookup_batch(
+        ents, [](Entity) {},
+        [&](size_t i, Entity idx) { out[i] = idx != INVALID; });
+  }
+
+  /**
+   * out[i] = dense index of ents[i], or INVALID if it is not present.
+   * Complexity: O(n), vectorized for 32-bit ids
+   */
+  void index_of_many(Span<const Entity> ents, Entity *out) const {
+    if constexpr (std::is_same_v<Entity, uint32_t>) {
+      sparse_filter::lookup_many(filter_table(), ents.data(), ents.size(),
+                                 out);
+    } else {
+      for (size_t i = 0; i < ents.size(); i++)
+        out[i] = contains(ents[i]) ? index_of(ents[i]) : INVALID;
+    }
+  }
+
+  // out[i] = contains(ents[i]), through index_of_many
+  void contains_many(Span<const Entity> ents, bool *out) const {
+    Entity idx[256];
+    for (size_t base = 0; base < ents.size(); base += 256) {
+      const size_t n = std::min<size_t>(256, ents.size() - base);
+      index_of_many(ents.subspan(base, n), idx);
+      for (size_t i = 0; i < n; i++)
+        out[base + i] = idx[i] != INVALID;
+    }
+  }
+
+  /**
+   * Copy the entities of ents that are in this set to out, in order, and
+   * return how many there are. out needs room for ents.size() entries
+   * and may be ents.data() itself: intersecting a dense entity list with
+   * further sets is a chain of in-place filter() calls.
+   * Complexity: O(n), vectorized for 32-bit ids
+   */
+  size_t filter(Span<const Entity> ents, Entity *out) const {
+    if constexpr (std::is_same_v<Entity, uint32_t>) {
+      return sparse_filter::filter_present(filter_table(), ents.data(),
+                                           ents.size(), out);
+    } else {
+      size_t count = 0;
+      for (Entity e : ents)
+        if (contains(e))
+          out[count++] = e;
+      return count;
+    }
+  }
+
+  /**
+   * Swap the dense slots a and b, keeping the sparse table in sync.
+   * Complexity: O(1)
+   */
+  void swap_dense(size_t a, size_t b) {
+    Entity ea = dense_entities[a];
+    Entity eb = dense_entities[b];
+    std::swap(dense_entities[a], dense_entities[b]);
+    sparse_ref(ea) = static_cast<Entity>(b);
+    sparse_ref(eb) = static_cast<Entity>(a);
+  }
+
+  /**
+   * Reorder the dense list by ascending entity id, so walking it touches
+   * other sparse tables and component arrays in address order. Not for
+   * sets with TOMBSTONE slots (same for clear()).
+   * Complexity: O(n log n)
+   */
+  void sort() {
+    std::sort(dense_entities.begin(), dense_entities.end());
+    for (size_t i = 0; i < dense_entities.size(); i++)
+      sparse_ref(dense_entities[i]) = static_cast<Entity>(i);
+  }
+
+  /**
+   * Drop the dense slots from n on; all of them must be TOMBSTONE.
+   * Complexity: O(size() - n)
+   */
+  void truncate(size_t n) {
+    assert(std::all_of(dense_entities.begin() + n, dense_entities.end(),
+                       [](Entity e) { return e == TOMBSTONE; }));
+    dense_entities.resize(n);
+  }
+
+  void clear() {
+    for (Entity e : dense_entities)
+      if (e != TOMBSTONE)
+        clear_slot(e);
+    dense_entities.clear();
+  }
+
+  /**
+   * Release sparse pages without live entries (reserve() allocates pages
+   * before their entries are inserted) and trim the page table and the
+   * dense list to their contents. Returns the bytes given back.
+   */
+  size_t shrink_to_fit() {
+    size_t freed = 0;
+    for (size_t p = 0; p < pages.size(); p++)
+      if (pages[p] && page_live[p] == 0) {
+        free_page(pages[p]);
+        pages[p] = nullptr;
+        freed += PAGE_BYTES;
+      }
+    while (!pages.empty() && !pages.back()) {
+      pages.pop_back();
+      page_live.pop_back();
+    }
+    const size_t before = table_bytes();
+    pages.shrink_to_fit();
+    page_live.shrink_to_fit();
+    dense_entities.shrink_to_fit();
+    freed += before - table_bytes();
+    reclaimed += freed;
+    return freed;
+  }
+
+  // Bytes held by allocated sparse pages
+  size_t sparse_bytes() const {
+    size_t bytes = 0;
+    for (const Entity *p : pages)
+      bytes += p ? PAGE_BYTES : 0;
+    return bytes;
+  }
+
+  // Bytes held by the page table and the dense list (capacity)
+  size_t table_bytes() const {
+    return pages.capacity() * sizeof(Entity *) +
+           page_live.capacity() * sizeof(uint16_t) +
+           dense_entities.capacity() * sizeof(Entity);
+  }
+
+  // Bytes this set gave back so far: emptied pages and shrink_to_fit()
+  size_t reclaimed_bytes() const { return reclaimed; }
+
+  // Number of dense slots (stored entities plus TOMBSTONE slots)
+  size_t size() const { return dense_entities.size(); }
+
+  // Dense list of entity IDs
+  const std::vector<Entity> &entities() const { return dense_entities; }
+
+private:
+  // ==================================================================
+  // Internal storage
+  // ==================================================================
+
+  static constexpr size_t PAGE_BYTES = sizeof(Entity) * SPARSE_SET_PAGE_SIZE;
+
+  // The tables sparse_filter's kernels read
+  sparse_filter::Table filter_table() const {
+    static_assert(sparse_filter::Table::PAGE_BITS == SPARSE_SET_PAGE_BITS);
+    return {pages.data(), pages.size(), dense_entities.data()};
+  }
+
+  // Sparse paged storage:
+  // pages[p][i] = dense index for entity = (p << bits) | i
+  std::vector<Entity *> pages;
+  // number of entries of pages[p] that are not INVALID
+  std::vector<uint16_t> page_live;
+  // where pages come from and go to (nullptr: malloc/free)
+  SparsePagePool<Entity> *pool = nullptr;
+  size_t reclaimed = 0;
+
+  // packed list of entity IDs
+  std::vector<Entity> dense_entities;
+};
+
+#ifdef RECS_MAPPED_SPARSE
+/**
+ * ======================================================================
+ * MappedEntitySet<Entity>
+ * ======================================================================
+ *
+ * EntitySet with a flat sparse table instead of pages. The table covers
+ * every possible entity id and is reserved once with mmap; the kernel
+ * backs it with zero pages as they are first touched, so only the ranges
+ * that hold entities cost memory.
+ *
+ *   slots[e] = dense index + 1   (0 if e is not present)
+ *
+ * Storing the index off by one makes the kernel's zero fill mean
+ * "absent": no INVALID fill loop and no page pointer to load before the
+ * slot. Emptied OS pages are counted per page and handed back to the
+ * kernel by shrink_to_fit() (madvise), not on every erase.
+ *
+ * Costs 16 GiB of address space per set for 32-bit ids (nothing committed
+ * up front). Only available where RECS_MAPPED_SPARSE is defined.
+ *
+ * ======================================================================
+ */
+template <typename Entity = uint32_t> class MappedEntitySet {
+public:
+  static_assert(sizeof(Entity) <= sizeof(uint32_t),
+                "MappedEntitySet reserves the whole id range: 32-bit ids "
+                "at most");
+
+  static constexpr Entity INVALID = EntitySet<Entity>::INVALID;
+  static constexpr Entity TOMBSTONE = EntitySet<Entity>::TOMBSTONE;
+
+  MappedEntitySet() {
+    void *p = mmap(nullptr, TABLE_BYTES, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED)
+      throw std::bad_alloc();
+    slots = static_cast<Entity *>(p);
+    os_page = size_t(sysconf(_SC_PAGESIZE));
+    while ((size_t(1) << chunk_bits) * sizeof(Entity) < os_page)
+      chunk_bits++;
+  }
+
+  ~MappedEntitySet() { munmap(slots, TABLE_BYTES); }
+
+  MappedEntitySet(const MappedEntitySet &) = delete;
+  MappedEntitySet &operator=(const MappedEntitySet &) = delete;
+
+  // No pages to share: the kernel is the pool.
+  void use_pool(SparsePagePool<Entity> *) {}
+
+  bool contains(Entity e) const {
+    const Entity s = slots[e];
+    return s != 0 && dense_entities[s - 1] == e;
+  }
+
+  size_t insert(Entity e) {
+    assert(!contains(e));
+    slots[e] = static_cast<Entity>(dense_entities.size() + 1);
+    count_slot(e);
+    dense_entities.push_back(e);
+    return dense_entities.size() - 1;
+  }
+
+  // Reserve dense room for the n entities in ents and the page counters
+  // up to the largest. The table itself needs no reservation.
+  void reserve(const Entity *ents, size_t n) {
+    if (n == 0)
+      return;
+    dense_entities.reserve(dense_entities.size() + n);
+    const size_t last_chunk =
+        size_t(*std::max_element(ents, ents + n)) >> chunk_bits;
+    if (last_chunk >= chunk_live.size()) {
+      chunk_live.resize(last_chunk + 1, 0);
+      chunk_touched.resize(last_chunk + 1, false);
+    }
+  }
+
+  // An entity listed more than once is added once.
+  void insert_bulk(const Entity *ents, size_t n) {
+    reserve(ents, n);
+    for (size_t i = 0; i < n; i++) {
+      if (slots[ents[i]] != 0) {
+        assert(dense_entities[slots[ents[i]] - 1] == ents[i]);
+        continue;
+      }
+      slots[ents[i]] = static_cast<Entity>(dense_entities.size() + 1);
+      count_slot(ents[i]);
+      dense_entities.push_back(ents[i]);
+    }
+  }
+
+  size_t erase(Entity e) {
+    assert(contains(e));
+    const Entity idx = index_of(e);
+    const Entity last_entity = dense_entities.back();
+    dense_entities[idx] = last_entity;
+    slots[last_entity] = idx + 1;
+    dense_entities.pop_back();
+    clear_slot(e);
+    return idx;
+  }
+
+  size_t erase_in_place(Entity e) {
+    assert(contains(e));
+    const size_t idx = index_of(e);
+    dense_entities[idx] = TOMBSTONE;
+    clear_slot(e);
+    return idx;
+  }
+
+  void insert_at(Entity e, size_t idx) {
+    assert(!contains(e) && dense_entities[idx] == TOMBSTONE);
+    slots[e] = static_cast<Entity>(idx + 1);
+    count_slot(e);
+    dense_entities[idx] = e;
+  }
+
+  Entity index_of(Entity e) const { return slots[e] - 1; }
+
+  static constexpr size_t BATCH_AHEAD = EntitySet<Entity>::BATCH_AHEAD;
+
+  // See EntitySet::lookup_batch; the slot address needs no page load.
+  template <typename Touch, typename Fn>
+  void lookup_batch(Span<const Entity> ents, Touch &&touch, Fn &&fn) const {
+    const size_t n = ents.size();
+    for (size_t i = 0; i < n; i++) {
+      if (i + 2 * BATCH_AHEAD < n)
+        sparse_prefetch(&slots[ents[i + 2 * BATCH_AHEAD]]);
+      if (i + BATCH_AHEAD < n)
+        if (const Entity s = slots[ents[i + BATCH_AHEAD]])
+          touch(static_cast<Entity>(s - 1));
+      const Entity s = slots[ents[i]];
+      fn(i, static_cast<Entity>(s - 1)); // 0 - 1 wraps to INVALID
+    }
+  }
+
+  void contains_batch(Span<const Entity> ents, bool *out) const {
+    lookup_batch(
+        ents, [](Entity) {},
+        [&](size_t i, Entity idx) { out[i] = idx != INVALID; });
+  }
+
+  // Scalar: a flat table leaves only one load per id to gather.
+  void index_of_many(Span<const Entity> ents, Entity *out) const {
+    for (size_t i = 0; i < ents.size(); i++)
+      out[i] = contains(ents[i]) ? index_of(ents[i]) : INVALID;
+  }
+
+  void contains_many(Span<const Entity> ents, bool *out) const {
+    for (size_t i = 0; i < ents.size(); i++)
+      out[i] = contains(ents[i]);
+  }
+
+  size_t filter(Span<const Entity> ents, Entity *out) const {
+    size_t count = 0;
+    for (Entity e : ents)
+      if (contains(e))
+        out[count++] = e;
+    return count;
+  }
+
+  void swap_dense(size_t a, size_t b) {
+    const Entity ea = dense_entities[a];
+    const Entity eb = dense_entities[b];
+    std::swap(dense_entities[a], dense_entities[b]);
+    slots[ea] = static_cast<Entity>(b + 1);
+    slots[eb] = static_cast<Entity>(a + 1);
+  }
+
+  void sort() {
+    std::sort(dense_entities.begin(), dense_entities.end());
+    for (size_t i = 0; i < dense_entities.size(); i++)
+      slots[dense_entities[i]] = static_cast<Entity>(i + 1);
+  }
+
+  void truncate(size_t n) {
+    assert(std::all_of(dense_entities.begin() + n, dense_entities.end(),
+                       [](Entity e) { return e == TOMBSTONE; }));
+    dense_entities.resize(n);
+  }
+
+  void clear() {
+    for (Entity e : dense_entities)
+      if (e != TOMBSTONE)
+        clear_slot(e);
+    dense_entities.clear();
+  }
+
+  /**
+   * Give the OS pages without live entries back to the kernel (they read
+   * as zero again afterwards) and trim the dense list. Returns the bytes
+   * released.
+   */
+  size_t shrink_to_fit() {
+    size_t freed = 0;
+    for (size_t c = 0; c < chunk_live.size();) {
+      if (chunk_live[c] != 0 || !chunk_touched[c]) {
+        c++;
+        continue;
+      }
+      // one madvise per run of empty pages
+      size_t end = c;
+      while (end < chunk_live.size() && chunk_live[end] == 0 &&
+             chunk_touched[end]) {
+        chunk_touched[end] = false;
+        end++;
+      }
+      madvise(reinterpret_cast<char *>(slots) + c * os_page,
+              (end - c) * os_page, MADV_DONTNEED);
+      freed += (end - c) * os_page;
+      c = end;
+    }
+    touched_pages -= freed / os_page;
+    const size_t before = table_bytes();
+    dense_entities.shrink_to_fit();
+    freed += before - table_bytes();
+    reclaimed += freed;
+    return freed;
+  }
+
+  // Bytes of the table written since the last shrink_to_fit() (resident)
+  size_t sparse_bytes() const { return touched_pages * os_page; }
+
+  // Bytes held by the page counters and the dense list (capacity)
+  size_t table_bytes() const {
+    return chunk_live.capacity() * sizeof(uint16_t) +
+           chunk_touched.capacity() / 8 +
+           dense_entities.capacity() * sizeof(Entity);
+  }
+
+  size_t reclaimed_bytes() const { return reclaimed; }
+
+  size_t size() const { return dense_entities.size(); }
+
+  const std::vector<Entity> &entities() const { return dense_entities; }
+
+private:
+  // one slot per id below INVALID
+  static constexpr size_t TABLE_BYTES = size_t(INVALID) * sizeof(Entity);
+
+  // Count a newly set slot against its OS page.
+  void count_slot(Entity e) {
+    const size_t c = size_t(e) >> chunk_bits;
+    if (c >= chunk_live.size()) {
+      chunk_live.resize(c + 1, 0);
+      chunk_touched.resize(c + 1, false);
+    }
+    if (chunk_live[c]++ == 0 && !chunk_touched[c]) {
+      chunk_touched[c] = true;
+      touched_pages++;
+    }
+  }
+
+  void clear_slot(Entity e) {
+    slots[e] = 0;
+    chunk_live[size_t(e) >> chunk_bits]--;
+  }
+
+  // flat sparse table, see above
+  Entity *slots = nullptr;
+  size_t os_page = 0;
+  // log2 of the slots per OS page
+  size_t chunk_bits = 0;
+  // live slots per OS page of the table
+  std::vector<uint16_t> chunk_live;
+  // pages written to since their last madvise
+  std::vector<bool> chunk_touched;
+  size_t touched_pages = 0;
+  size_t reclaimed = 0;
+
+  std::vector<Entity> dense_entities;
+};
+#endif
+
+/**
+ * SparseSet<T, Entity, Index>: Index is the sparse table + dense entity
+ * list, EntitySet by default or MappedEntitySet for huge id ranges.
+ */
+template <typename T, typename Entity = uint32_t,
+          typename Index = EntitySet<Entity>>
+class SparseSet {
+public:
+  static_assert(
+      !std::is_void_v<T>,
+      "SparseSet<T=void> is not allowed. Use a tag component instead.");
+
+  // Value stored in sparse table when element is not present.
+  static constexpr Entity INVALID = EntitySet<Entity>::INVALID;
+
+  // erase() swap-removes: the dense range has no holes
+  static constexpr bool in_place_delete = false;
+
+  // Paging constants, see EntitySet
+  static constexpr size_t SPARSE_SET_PAGE_BITS =
+      EntitySet<Entity>::SPARSE_SET_PAGE_BITS;
+  static constexpr size_t SPARSE_SET_PAGE_SIZE =
+      EntitySet<Entity>::SPARSE_SET_PAGE_SIZE;
+  static constexpr size_t SPARSE_SET_PAGE_MASK =
+      EntitySet<Entity>::SPARSE_SET_PAGE_MASK;
+
+  SparseSet() = default;
+
+  // ==================================================================
+  // Public API
+  // ==================================================================
+
+  /**
+   * Check whether entity e exists in the set.
+   * Complexity: O(1)
+   */
+  bool contains(Entity e) const { return index.contains(e); }
+
   /**
    * Insert or update a component for entity e.
    * Returns reference to the stored component.
@@ -147,24 +922,55 @@ public:
    *   Insert empty → O(1)
    *   Overwrite    → O(1)
    */
-  T &insert(Entity e, const T &value = T()) {
+  T &insert(Entity e, const T &value = T()) { return emplace(e, value); }
+  T &insert(Entity e, T &&value) { return emplace(e, std::move(value)); }
+
+  /**
+   * Insert or overwrite e's component, constructed from args: T(args...)
+   * when T has such a constructor, T{args...} otherwise (aggregates).
+   * A new component is built directly in the dense array; an existing one
+   * is move-assigned from the new value.
+   *
+   * Complexity: O(1) amortized
+   */
+  template <typename... Args> T &emplace(Entity e, Args &&...args) {
     if (contains(e)) {
-      // Overwrite existing component
-      Entity idx = sparse_ref(e);
-      components[idx] = value;
-      return components[idx];
+      T &slot = components[index.index_of(e)];
+      slot = make(std::forward<Args>(args)...);
+      return slot;
     }
 
-    // New entity: append to dense arrays
-    Entity &slot = sparse_ref(e);
-    slot = static_cast<Entity>(dense_entities.size());
-
-    dense_entities.push_back(e);
-    components.push_back(value);
-
+    // New entity: append to dense arrays. Construct first: a throwing
+    // constructor leaves the set unchanged
+    if constexpr (std::is_constructible_v<T, Args &&...>)
+      components.emplace_back(std::forward<Args>(args)...);
+    else
+      components.push_back(T{std::forward<Args>(args)...});
+    index.insert(e);
     return components.back();
   }
 
+  /**
+   * Insert or overwrite the components of n entities at once.
+   * Reserves the dense arrays and sparse pages once, then fills them in a
+   * single pass. values[i] belongs to ents[i]; an entity listed more than
+   * once keeps its last value, as with repeated insert() calls.
+   *
+   * Complexity: O(n)
+   */
+  void insert_bulk(const Entity *ents, const T *values, size_t n) {
+    index.reserve(ents, n);
+    components.reserve(components.size() + n);
+    for (size_t i = 0; i < n; i++) {
+      if (index.contains(ents[i])) {
+        components[index.index_of(ents[i])] = values[i];
+        continue;
+      }
+      index.insert(ents[i]);
+      components.push_back(values[i]);
+    }
+  }
+
   /**
    * Erase entity e from the set.
    * Preserves packed iteration order by swap-removing.
@@ -175,23 +981,11 @@ public:
     if (!contains(e))
       return;
 
-    Entity idx = sparse_ref(e);
-    Entity last_idx = static_cast<Entity>(dense_entities.size() - 1);
-    Entity last_entity = dense_entities[last_idx];
-
-    // Move last into removed slot
-    dense_entities[idx] = last_entity;
-    components[idx] = components[last_idx];
-
-    // Update sparse entry for swapped element
-    sparse_ref(last_entity) = idx;
-
-    // Remove last
-    dense_entities.pop_back();
+    // Move last into removed slot, then drop the last
+    size_t idx = index.erase(e);
+    if (idx + 1 != components.size())
+      components[idx] = std::move(components.back());
     components.pop_back();
-
-    // Invalidate removed sparse entry
-    sparse_ref(e) = INVALID;
   }
 
   /**
@@ -201,11 +995,73 @@ public:
    */
   T &get(Entity e) {
     assert(contains(e));
-    return components[sparse_ref(e)];
+    return components[index.index_of(e)];
   }
   const T &get(Entity e) const {
     assert(contains(e));
-    return components[sparse_ref(e)];
+    return components[index.index_of(e)];
+  }
+
+  /**
+   * Dense index of an entity known to be present (no checks).
+   * Used by hot loops that already validated membership.
+   * Complexity: O(1)
+   */
+  Entity index_of(Entity e) const { return index.index_of(e); }
+
+  /**
+   * Component of an entity known to be present (no checks).
+   * Complexity: O(1)
+   */
+  T &get_unchecked(Entity e) { return components[index.index_of(e)]; }
+  const T &get_unchecked(Entity e) const {
+    return components[index.index_of(e)];
+  }
+
+  // Component in dense slot pos (no checks)
+  T &dense_at(size_t pos) { return components[pos]; }
+  const T &dense_at(size_t pos) const { return components[pos]; }
+
+  /**
+   * out[i] = &get(ents[i]), or nullptr if ents[i] is not present. Sparse
+   * slots and components are prefetched ahead (see
+   * EntitySet::lookup_batch), which pays off for random batches.
+   * Complexity: O(n)
+   */
+  void get_batch(Span<const Entity> ents, T **out) {
+    index.lookup_batch(
+        ents, [&](Entity idx) { sparse_prefetch(&components[idx]); },
+        [&](size_t i, Entity idx) {
+          out[i] = idx != INVALID ? &components[idx] : nullptr;
+        });
+  }
+
+  // out[i] = contains(ents[i]), prefetching ahead like get_batch
+  void contains_batch(Span<const Entity> ents, bool *out) const {
+    index.contains_batch(ents, out);
+  }
+
+  // Bulk membership / index translation / intersection, see EntitySet
+  void contains_many(Span<const Entity> ents, bool *out) const {
+    index.contains_many(ents, out);
+  }
+  void index_of_many(Span<const Entity> ents, Entity *out) const {
+    index.index_of_many(ents, out);
+  }
+  size_t filter(Span<const Entity> ents, Entity *out) const {
+    return index.filter(ents, out);
+  }
+
+  /**
+   * Swap the dense slots a and b (entity and component), keeping the
+   * sparse table in sync. Used to keep related sets in the same order.
+   * Complexity: O(1)
+   */
+  void swap_dense(size_t a, size_t b) {
+    if (a == b)
+      return;
+    index.swap_dense(a, b);
+    std::swap(components[a], components[b]);
   }
 
   // Convenience: set[e] == get(e)
@@ -221,38 +1077,469 @@ public:
    * Calls f(entity, component_reference).
    */
   template <typename Func> void for_each(Func &&f) {
-    size_t n = dense_entities.size();
+    const auto &ents = index.entities();
+    size_t n = ents.size();
     for (size_t i = 0; i < n; i++) {
-      f(dense_entities[i], components[i]);
+      f(ents[i], components[i]);
     }
   }
   template <typename Func> void for_each(Func &&f) const {
-    size_t n = dense_entities.size();
+    const auto &ents = index.entities();
+    size_t n = ents.size();
     for (size_t i = 0; i < n; i++) {
-      f(dense_entities[i], components[i]);
+      f(ents[i], components[i]);
     }
   }
 
   // Number of stored components
-  size_t size() const { return dense_entities.size(); }
+  size_t size() const { return index.size(); }
 
   // Dense list of entity IDs
-  const std::vector<Entity> &entities() const { return dense_entities; }
+  const std::vector<Entity> &entities() const { return index.entities(); }
+
+  // ==================================================================
+  // Memory
+  // ==================================================================
+
+  // Take sparse pages from a shared pool, see EntitySet::use_pool
+  void use_pool(SparsePagePool<Entity> *pool) { index.use_pool(pool); }
+
+  // Release empty sparse pages and trim the dense arrays to size.
+  // Returns the bytes given back.
+  size_t shrink_to_fit() {
+    const size_t before = components.capacity();
+    components.shrink_to_fit();
+    const size_t freed = (before - components.capacity()) * sizeof(T);
+    reclaimed += freed;
+    return freed + index.shrink_to_fit();
+  }
+
+  size_t sparse_bytes() const { return index.sparse_bytes(); }
+  size_t dense_bytes() const {
+    return index.table_bytes() + components.capacity() * sizeof(T);
+  }
+  size_t reclaimed_bytes() const { return reclaimed + index.reclaimed_bytes(); }
 
   // Dense component storage
   std::vector<T> &data() { return components; }
   const std::vector<T> &data() const { return components; }
 
 private:
+  // T(args...) if T has that constructor, else T{args...}
+  template <typename... Args> static T make(Args &&...args) {
+    if constexpr (std::is_constructible_v<T, Args &&...>)
+      return T(std::forward<Args>(args)...);
+    else
+      return T{std::forward<Args>(args)...};
+  }
+
   // ==================================================================
   // Internal storage
   // ==================================================================
 
-  // Sparse paged storage:
-  // pages[p][i] = dense index for entity = (p << bits) | i
-  std::vector<Entity *> pages;
+  // Sparse table + packed list of entity IDs
+  Index index;
+
+  // packed component storage, components[i] belongs to entities()[i]
+  std::vector<T> components;
+  // component bytes released by shrink_to_fit()
+  size_t reclaimed = 0;
+};
+
+/**
+ * ======================================================================
+ * TagSet<T, Entity>
+ * ======================================================================
+ *
+ * SparseSet interface for empty (tag) component types: only the sparse
+ * table and the packed entity list, no component array. All objects of an
+ * empty type are alike, so every accessor hands out the same T instance.
+ *
+ * ======================================================================
+ */
+template <typename T, typename Entity = uint32_t> class TagSet {
+public:
+  static_assert(std::is_empty_v<T>, "TagSet<T> needs an empty T");
+
+  static constexpr Entity INVALID = EntitySet<Entity>::INVALID;
+  static constexpr bool in_place_delete = false;
+
+  bool contains(Entity e) const { return index.contains(e); }
+
+  /**
+   * Insert e if it is not present yet. The value carries no state.
+   * Complexity: O(1)
+   */
+  T &insert(Entity e, const T & = T()) {
+    if (!contains(e))
+      index.insert(e);
+    return tag;
+  }
+
+  template <typename... Args> T &emplace(Entity e, Args &&...) {
+    return insert(e);
+  }
 
-  // Dense arrays
-  std::vector<Entity> dense_entities; //< packed list of entity IDs
-  std::vector<T> components;          //< packed component storage
+  /**
+   * Insert n entities at once; values are ignored (may be nullptr).
+   * Complexity: O(n)
+   */
+  void insert_bulk(const Entity *ents, const T *, size_t n) {
+    index.reserve(ents, n);
+    for (size_t i = 0; i < n; i++)
+      if (!index.contains(ents[i]))
+        index.insert(ents[i]);
+  }
+
+  void erase(Entity e) {
+    if (contains(e))
+      index.erase(e);
+  }
+
+  T &get(Entity e) {
+    assert(contains(e));
+    return tag;
+  }
+  const T &get(Entity e) const {
+    assert(contains(e));
+    return tag;
+  }
+
+  Entity index_of(Entity e) const { return index.index_of(e); }
+
+  T &get_unchecked(Entity) { return tag; }
+  const T &get_unchecked(Entity) const { return tag; }
+
+  T &dense_at(size_t) { return tag; }
+  const T &dense_at(size_t) const { return tag; }
+
+  // Membership is all there is to look up.
+  void get_batch(Span<const Entity> ents, T **out) {
+    index.lookup_batch(
+        ents, [](Entity) {},
+        [&](size_t i, Entity idx) {
+          out[i] = idx != INVALID ? &tag : nullptr;
+        });
+  }
+
+  void contains_batch(Span<const Entity> ents, bool *out) const {
+    index.contains_batch(ents, out);
+  }
+
+  // Bulk membership / index translation / intersection, see EntitySet
+  void contains_many(Span<const Entity> ents, bool *out) const {
+    index.contains_many(ents, out);
+  }
+  void index_of_many(Span<const Entity> ents, Entity *out) const {
+    index.index_of_many(ents, out);
+  }
+  size_t filter(Span<const Entity> ents, Entity *out) const {
+    return index.filter(ents, out);
+  }
+
+  void swap_dense(size_t a, size_t b) {
+    if (a != b)
+      index.swap_dense(a, b);
+  }
+
+  template <typename Func> void for_each(Func &&f) {
+    for (Entity e : index.entities())
+      f(e, tag);
+  }
+
+  size_t size() const { return index.size(); }
+
+  const std::vector<Entity> &entities() const { return index.entities(); }
+
+  void use_pool(SparsePagePool<Entity> *pool) { index.use_pool(pool); }
+  size_t shrink_to_fit() { return index.shrink_to_fit(); }
+  size_t sparse_bytes() const { return index.sparse_bytes(); }
+  size_t dense_bytes() const { return index.table_bytes(); }
+  size_t reclaimed_bytes() const { return index.reclaimed_bytes(); }
+
+private:
+  EntitySet<Entity> index;
+  T tag;
+};
+
+/**
+ * ======================================================================
+ * PagedSet<T, Entity, PageSize, InPlaceDelete>
+ * ======================================================================
+ *
+ * SparseSet interface with the components in fixed-size pages of PageSize
+ * elements instead of one vector. Growing allocates one more page and
+ * never moves existing components: no copy spike when a large storage
+ * outgrows its capacity, and references from insert/get survive growth.
+ *
+ * With InPlaceDelete, erase destroys the component where it is and leaves
+ * a hole (a TOMBSTONE entry in entities()) that a later insert reuses.
+ * Nothing ever moves, so a component keeps its address for as long as its
+ * entity has it. Without it, erase swap-removes like SparseSet.
+ *
+ * entities() spans the holes as well; size() counts components only.
+ *
+ * ======================================================================
+ */
+template <typename T, typename Entity, size_t PageSize, bool InPlaceDelete>
+class PagedSet {
+public:
+  static_assert(PageSize > 0 && (PageSize & (PageSize - 1)) == 0,
+                "PageSize must be a power of two");
+
+  static constexpr Entity INVALID = EntitySet<Entity>::INVALID;
+  static constexpr Entity TOMBSTONE = EntitySet<Entity>::TOMBSTONE;
+  static constexpr bool in_place_delete = InPlaceDelete;
+
+  PagedSet() = default;
+  PagedSet(const PagedSet &) = delete;
+  PagedSet &operator=(const PagedSet &) = delete;
+
+  ~PagedSet() {
+    const auto &ents = index.entities();
+    for (size_t i = 0; i < ents.size(); i++)
+      if (ents[i] != TOMBSTONE)
+        dense_at(i).~T();
+    for (T *page : pages)
+      ::operator delete(page, std::align_val_t(alignof(T)));
+  }
+
+  bool contains(Entity e) const { return index.contains(e); }
+
+  T &insert(Entity e, const T &value = T()) { return emplace(e, value); }
+  T &insert(Entity e, T &&value) { return emplace(e, std::move(value)); }
+
+  /**
+   * Insert or overwrite e's component, constructed from args as in
+   * SparseSet::emplace. A new component goes into the most recent hole
+   * (InPlaceDelete) or the end of the dense range.
+   * Complexity: O(1), plus one page allocation every PageSize inserts
+   */
+  template <typename... Args> T &emplace(Entity e, Args &&...args) {
+    if (contains(e)) {
+      T &slot = dense_at(index.index_of(e));
+      slot = make(std::forward<Args>(args)...);
+      return slot;
+    }
+
+    const bool reuse = InPlaceDelete && !holes.empty();
+    const size_t pos = reuse ? holes.back() : index.size();
+    if (pos / PageSize >= pages.size())
+      pages.push_back(static_cast<T *>(::operator new(
+          sizeof(T) * PageSize, std::align_val_t(alignof(T)))));
+    // construct first: a throwing constructor leaves the set unchanged
+    T *slot = slot_ptr(pos);
+    if constexpr (std::is_constructible_v<T, Args &&...>)
+      new (slot) T(std::forward<Args>(args)...);
+    else
+      new (slot) T{std::forward<Args>(args)...};
+    if (reuse) {
+      holes.pop_back();
+      index.insert_at(e, pos);
+    } else {
+      index.insert(e);
+    }
+    return *slot;
+  }
+
+  /**
+   * Insert or overwrite n components; values[i] belongs to ents[i].
+   * Complexity: O(n)
+   */
+  void insert_bulk(const Entity *ents, const T *values, size_t n) {
+    index.reserve(ents, n);
+    for (size_t i = 0; i < n; i++)
+      emplace(ents[i], values[i]);
+  }
+
+  /**
+   * Erase e's component. InPlaceDelete: destroy it and leave a hole.
+   * Otherwise: move the last component into its slot.
+   * Complexity: O(1)
+   */
+  void erase(Entity e) {
+    if (!contains(e))
+      return;
+    if constexpr (InPlaceDelete) {
+      const size_t pos = index.erase_in_place(e);
+      dense_at(pos).~T();
+      holes.push_back(pos);
+    } else {
+      const size_t last = index.size() - 1;
+      const size_t pos = index.erase(e);
+      if (pos != last)
+        dense_at(pos) = std::move(dense_at(last));
+      dense_at(last).~T();
+    }
+  }
+
+  T &get(Entity e) {
+    assert(contains(e));
+    return dense_at(index.index_of(e));
+  }
+  const T &get(Entity e) const {
+    assert(contains(e));
+    return dense_at(index.index_of(e));
+  }
+
+  Entity index_of(Entity e) const { return index.index_of(e); }
+
+  T &get_unchecked(Entity e) { return dense_at(index.index_of(e)); }
+  const T &get_unchecked(Entity e) const {
+    return dense_at(index.index_of(e));
+  }
+
+  // Component in dense slot pos (no checks; pos must not be a hole)
+  T &dense_at(size_t pos) { return *slot_ptr(pos); }
+  const T &dense_at(size_t pos) const { return *slot_ptr(pos); }
+
+  // See SparseSet::get_batch
+  void get_batch(Span<const Entity> ents, T **out) {
+    index.lookup_batch(
+        ents, [&](Entity idx) { sparse_prefetch(slot_ptr(idx)); },
+        [&](size_t i, Entity idx) {
+          out[i] = idx != INVALID ? slot_ptr(idx) : nullptr;
+        });
+  }
+
+  void contains_batch(Span<const Entity> ents, bool *out) const {
+    index.contains_batch(ents, out);
+  }
+
+  // Bulk membership / index translation / intersection, see EntitySet
+  void contains_many(Span<const Entity> ents, bool *out) const {
+    index.contains_many(ents, out);
+  }
+  void index_of_many(Span<const Entity> ents, Entity *out) const {
+    index.index_of_many(ents, out);
+  }
+  size_t filter(Span<const Entity> ents, Entity *out) const {
+    return index.filter(ents, out);
+  }
+
+  // Swap two occupied dense slots. Moves components, so it gives up the
+  // address stability InPlaceDelete provides.
+  void swap_dense(size_t a, size_t b) {
+    if (a == b)
+      return;
+    index.swap_dense(a, b);
+    std::swap(dense_at(a), dense_at(b));
+  }
+
+  // Walks page by page, skipping holes.
+  template <typename Func> void for_each(Func &&f) {
+    const auto &ents = index.entities();
+    for (size_t base = 0; base < ents.size(); base += PageSize) {
+      T *page = pages[base / PageSize];
+      const size_t n = std::min(PageSize, ents.size() - base);
+      for (size_t i = 0; i < n; i++)
+        if (!InPlaceDelete || ents[base + i] != TOMBSTONE)
+          f(ents[base + i], page[i]);
+    }
+  }
+
+  // Number of stored components (holes excluded)
+  size_t size() const { return index.size() - holes.size(); }
+
+  // Dense list of entity IDs, TOMBSTONE at holes
+  const std::vector<Entity> &entities() const { return index.entities(); }
+
+  void use_pool(SparsePagePool<Entity> *pool) { index.use_pool(pool); }
+
+  /**
+   * Release empty sparse pages and the component pages past the end of
+   * the dense range. Holes stay where they are (InPlaceDelete never moves
+   * a component), so only trailing ones can shrink the range.
+   */
+  size_t shrink_to_fit() {
+    if constexpr (InPlaceDelete)
+      drop_trailing_holes();
+    const size_t used = (index.size() + PageSize - 1) / PageSize;
+    size_t freed = 0;
+    while (pages.size() > used) {
+      ::operator delete(pages.back(), std::align_val_t(alignof(T)));
+      pages.pop_back();
+      freed += PAGE_BYTES;
+    }
+    const size_t before = pages.capacity() * sizeof(T *) +
+                          holes.capacity() * sizeof(size_t);
+    pages.shrink_to_fit();
+    holes.shrink_to_fit();
+    freed += before - pages.capacity() * sizeof(T *) -
+             holes.capacity() * sizeof(size_t);
+    reclaimed += freed;
+    return freed + index.shrink_to_fit();
+  }
+
+  size_t sparse_bytes() const { return index.sparse_bytes(); }
+  size_t dense_bytes() const {
+    return index.table_bytes() + pages.size() * PAGE_BYTES +
+           pages.capacity() * sizeof(T *) + holes.capacity() * sizeof(size_t);
+  }
+  size_t reclaimed_bytes() const { return reclaimed + index.reclaimed_bytes(); }
+
+private:
+  static constexpr size_t PAGE_BYTES = sizeof(T) * PageSize;
+
+  // Pop TOMBSTONE slots off the end of the dense range and forget them
+  // as holes.
+  void drop_trailing_holes() {
+    size_t end = index.size();
+    const auto &ents = index.entities();
+    while (end > 0 && ents[end - 1] == TOMBSTONE)
+      --end;
+    if (end == index.size())
+      return;
+    index.truncate(end);
+    holes.erase(std::remove_if(holes.begin(), holes.end(),
+                               [&](size_t pos) { return pos >= end; }),
+                holes.end());
+  }
+
+  template <typename... Args> static T make(Args &&...args) {
+    if constexpr (std::is_constructible_v<T, Args &&...>)
+      return T(std::forward<Args>(args)...);
+    else
+      return T{std::forward<Args>(args)...};
+  }
+
+  T *slot_ptr(size_t pos) const {
+    return pages[pos / PageSize] + pos % PageSize;
+  }
+
+  EntitySet<Entity> index;
+  // component pages; slot i lives at pages[i / PageSize][i % PageSize]
+  std::vector<T *> pages;
+  // dense slots freed by erase (InPlaceDelete), reused last-in first-out
+  std::vector<size_t> holes;
+  // component bytes released by shrink_to_fit()
+  size_t reclaimed = 0;
 };
+
+/**
+ * Per-type storage options. Specialize for a component type to change how
+ * its storage keeps the values:
+ *
+ *   template <> struct ComponentTraits<Particle> {
+ *     static constexpr size_t page_size = 4096;
+ *     static constexpr bool in_place_delete = true;
+ *   };
+ *
+ * page_size > 0 selects PagedSet (stable addresses while growing);
+ * in_place_delete additionally keeps addresses stable across erase, at the
+ * price of holes in the dense range. Empty (tag) types ignore both.
+ */
+template <typename T> struct ComponentTraits {
+  static constexpr size_t page_size = 0;
+  static constexpr bool in_place_delete = false;
+};
+
+// Set type that stores component T: TagSet for empty types, PagedSet when
+// ComponentTraits<T> asks for pages, SparseSet otherwise.
+template <typename T, typename Entity = uint32_t>
+using ComponentSet = std::conditional_t<
+    std::is_empty_v<T>, TagSet<T, Entity>,
+    std::conditional_t<(ComponentTraits<T>::page_size > 0),
+                       PagedSet<T, Entity, ComponentTraits<T>::page_size,
+                                ComponentTraits<T>::in_place_delete>,
+                       SparseSet<T, Entity>>>;
@@ -2,44 +2,84 @@
 #include "../entities/conway.h"
 #include "components.h"
 #include "ecs.h"
+#include "job_system.h"
+#include "scheduler.h"
 #include "raylib.h"
 
+// Rows are independent (each reads currentState, writes its own slice of
+// nextState), so both passes are split across the shared job system.
 inline void SimulateConway(ECS &ecs) {
-  for (int y = 0; y < ACTIVE_H; ++y) {
-    for (int x = 0; x < ACTIVE_W; ++x) {
-      int liveNeighbors = 0;
-
-      for (auto &offset : neighbor_offsets) {
-        int nx = x + static_cast<int>(offset.x);
-        int ny = y + static_cast<int>(offset.y);
-        if (nx >= 0 && nx < ACTIVE_W && ny >= 0 && ny < ACTIVE_H)
-          if (currentState[index(nx, ny)])
-            liveNeighbors++;
-      }
+  JobSystem &jobs = JobSystem::global();
+
+  jobs.parallel_for(ACTIVE_H, 8, [&](size_t y0, size_t y1) {
+    for (int y = (int)y0; y < (int)y1; ++y) {
+      for (int x = 0; x < ACTIVE_W; ++x) {
+        int liveNeighbors = 0;
 
-      bool alive = currentState[index(x, y)];
-      bool nextAlive = false;
+        for (auto &offset : neighbor_offsets) {
+          int nx = x + static_cast<int>(offset.x);
+          int ny = y + static_cast<int>(offset.y);
+          if (nx >= 0 && nx < ACTIVE_W && ny >= 0 && ny < ACTIVE_H)
+            if (currentState[index(nx, ny)])
+              liveNeighbors++;
+        }
 
-      if (alive)
-        nextAlive = (liveNeighbors == 2 || liveNeighbors == 3);
-      else
-        nextAlive = (liveNeighbors == 3);
+        bool alive = currentState[index(x, y)];
+        bool nextAlive = false;
 
-      nextState[index(x, y)] = nextAlive;
+        if (alive)
+          nextAlive = (liveNeighbors == 2 || liveNeighbors == 3);
+        else
+          nextAlive = (liveNeighbors == 3);
+
+        nextState[index(x, y)] = nextAlive;
+      }
     }
-  }
+  });
 
-  for (int i = 0; i < (int)gridEntities.size(); ++i) {
-    CellComponent &cell = ecs.get<CellComponent>(gridEntities[i]);
-    cell.color = nextState[i] ? WHITE : BLACK;
-  }
+  // every grid entity has a cell: skip the per-access checks
+  auto cells = ecs.storage<CellComponent>();
+  jobs.parallel_for(gridEntities.size(), 4096, [&](size_t b, size_t e) {
+    for (size_t i = b; i < e; ++i) {
+      CellComponent &cell = cells.get_unchecked(gridEntities[i].index);
+      cell.color = nextState[i] ? WHITE : BLACK;
+    }
+  });
 
   currentState.swap(nextState);
 }
 
 inline void RenderCells(ECS &ecs) {
-  ecs.view<CellComponent>([&](Entity e, CellComponent &quad) {
+  ecs.view<const CellComponent>([&](Entity, const CellComponent &quad) {
     if (is_alive(quad.color))
       DrawRectangleRec(quad.rect, quad.color);
   });
 }
+
+// FPS plus the wall time of every scheduled system in the last frame
+inline void DrawStats(const Scheduler &scheduler) {
+  const float size = defaultFont.baseSize * 2;
+  const Color color = {255, 80, 150, 255};
+  float y = 10;
+  DrawTextEx(defaultFont, TextFormat("FPS: %d", GetFPS()), (Vector2){10, y},
+             size, 1, color);
+  for (const Scheduler::Timing &t : scheduler.timings()) {
+    y += size;
+    DrawTextEx(defaultFont,
+               TextFormat("%s: %.2f ms", t.name->c_str(), t.last_ms),
+               (Vector2){10, y}, size, 1, color);
+  }
+}
+
+inline void RenderFrame(ECS &ecs, const Camera2D &camera,
+                        const Scheduler &scheduler) {
+  BeginDrawing();
+  ClearBackground((Color){20, 22, 34, 255});
+
+  BeginMode2D(camera);
+  RenderCells(ecs);
+
+  EndMode2D();
+  DrawStats(scheduler);
+  EndDrawing();
+}
@@ -28,16 +28,19 @@ inline void CreateConway(ECS &ecs) {
   std::uniform_real_distribution<> distProb(0.0, 1.0);
   const float aliveProbability = 0.65f;
 
-  for (int x = 0; x < ACTIVE_W; ++x) {
-    for (int y = 0; y < ACTIVE_H; ++y) {
-      int i = x + y * ACTIVE_W;
-      Entity e = ecs.create_entity();
+  std::vector<CellComponent> cells(ACTIVE_W * ACTIVE_H);
+  for (int y = 0; y < ACTIVE_H; ++y) {
+    for (int x = 0; x < ACTIVE_W; ++x) {
+      int i = index(x, y);
       bool alive = distProb(gen) < aliveProbability;
       Color cellColor = alive ? WHITE : BLACK;
-      ecs.add<CellComponent>(e, Rectangle{(float)(x), (float)(y), 1.f, 1.f},
-                             cellColor);
-      gridEntities[i] = e;
+      cells[i] = CellComponent(Rectangle{(float)(x), (float)(y), 1.f, 1.f},
+                               cellColor);
       currentState[i] = alive;
     }
   }
+
+  // one entity per cell, in grid order, stored in one batch
+  ecs.create_entities(gridEntities.size(), gridEntities.data());
+  ecs.add_bulk<CellComponent>(gridEntities, cells);
 }
@@ -16,6 +16,6 @@ Font defaultFont;
 
 const int ACTIVE_W = 639;
 const int ACTIVE_H = 359;
-std::vector<Entity> gridEntities; // size ACTIVE_W * ACTIVE_H
-std::vector<bool> currentState;   // size ACTIVE_W * ACTIVE_H
-std::vector<bool> nextState;      // size ACTIVE_W * ACTIVE_H
+std::vector<Entity> gridEntities;  // size ACTIVE_W * ACTIVE_H
+std::vector<uint8_t> currentState; // size ACTIVE_W * ACTIVE_H
+std::vector<uint8_t> nextState;    // size ACTIVE_W * ACTIVE_H
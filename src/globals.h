@@ -1,6 +1,7 @@
 #pragma once
 #include "engine/ecs.h" // your ECS and Entity definitions
 #include "raylib.h"     // for Color, Rectangle, etc.
+#include <cstdint>
 #include <vector>
 
 extern const int GAME_W;
@@ -10,6 +11,6 @@ extern Font defaultFont;
 
 extern const int ACTIVE_W;
 extern const int ACTIVE_H;
-extern std::vector<Entity> gridEntities; // size ACTIVE_W * ACTIVE_H
-extern std::vector<bool> currentState;   // size ACTIVE_W * ACTIVE_H
-extern std::vector<bool> nextState;      // size ACTIVE_W * ACTIVE_H
+extern std::vector<Entity> gridEntities;  // size ACTIVE_W * ACTIVE_H
+extern std::vector<uint8_t> currentState; // size ACTIVE_W * ACTIVE_H
+extern std::vector<uint8_t> nextState;    // size ACTIVE_W * ACTIVE_H
@@ -1,5 +1,6 @@
 // main.cpp
 #include "engine/ecs.h"
+#include "engine/scheduler.h"
 #include "engine/systems.h"
 #include "entities/conway.h"
 #include "globals.h"
@@ -25,23 +26,19 @@ int main() {
   ECS ecs;
   CreateConway(ecs);
 
+  // Systems (render stays on the main thread: it owns the GL context)
+  Scheduler scheduler;
+  scheduler.add("simulate", Reads<>{}, Writes<CellComponent>{},
+                [](ECS &ecs, float) { SimulateConway(ecs); });
+  scheduler.add_main(
+      "render", Reads<CellComponent>{}, Writes<>{},
+      [&](ECS &ecs, float) { RenderFrame(ecs, camera, scheduler); });
+
   while (!WindowShouldClose()) {
     float dt = GetFrameTime();
 
-    // UPDATE
-    SimulateConway(ecs);
-
-    // DRAW
-    BeginDrawing();
-    ClearBackground((Color){20, 22, 34, 255});
-
-    BeginMode2D(camera);
-    RenderCells(ecs);
-
-    EndMode2D();
-    DrawTextEx(defaultFont, TextFormat("FPS: %d", GetFPS()), (Vector2){10, 10},
-               defaultFont.baseSize * 2, 1, (Color){255, 80, 150, 255});
-    EndDrawing();
+    // UPDATE + DRAW
+    scheduler.run(ecs, dt);
   }
 
   // Cleanup
@@ -0,0 +1,83 @@
+#pragma once
+#include "../engine/archetype.h"
+#include "../engine/ecs.h"
+#include "ecs_sample_components.h"
+#include "test_lib.h"
+
+#include <vector>
+
+// ------------------------------------------------------------
+// BENCHMARKS
+// ------------------------------------------------------------
+// The same scenarios run on both storage backends (ECS and ArchetypeECS).
+
+// 1M entities, 4 components, 10 view passes over a prebuilt world.
+template <typename World> static void run_wide_view_1m_4c(World &ecs) {
+  for (int frame = 0; frame < 10; frame++) {
+    ecs.template view<Position, Velocity, Health, Acceleration>(
+        [&](Entity, Position &p, Velocity &v, Health &h, Acceleration &a) {
+          v.vx += a.ax;
+          p.x += v.vx;
+          h.hp -= 1;
+        });
+  }
+}
+
+template <typename World> static void build_wide_world_1m_4c(World &ecs) {
+  for (size_t i = 0; i < 1000000; i++) {
+    Entity e = ecs.create_entity();
+    ecs.template add<Position>(e, (float)i, (float)i);
+    if (i % 2 == 0)
+      ecs.template add<Velocity>(e, 1.f, 1.f);
+    if (i % 3 == 0)
+      ecs.template add<Health>(e, 100);
+    if (i % 5 != 0)
+      ecs.template add<Acceleration>(e, 0.5f, 0.5f);
+  }
+}
+
+// Add/remove churn on entities that carry several components.
+template <typename World> static void run_add_remove_churn() {
+  World ecs;
+  const size_t N = 100000;
+  std::vector<Entity> ents(N);
+  for (size_t i = 0; i < N; i++) {
+    ents[i] = ecs.create_entity();
+    ecs.template add<Position>(ents[i], (float)i, (float)i);
+    ecs.template add<Health>(ents[i], 100);
+  }
+  for (int round = 0; round < 4; round++) {
+    for (size_t i = 0; i < N; i++)
+      ecs.template add<Velocity>(ents[i], 1.f, 1.f);
+    for (size_t i = 0; i < N; i++)
+      ecs.template remove<Velocity>(ents[i]);
+  }
+}
+
+BENCH(bench_backend_sparse_wide_view_1m_4c) {
+  static ECS ecs;
+  static bool built = false;
+  if (!built) {
+    build_wide_world_1m_4c(ecs);
+    built = true;
+  }
+  run_wide_view_1m_4c(ecs);
+}
+
+BENCH(bench_backend_archetype_wide_view_1m_4c) {
+  static ArchetypeECS ecs;
+  static bool built = false;
+  if (!built) {
+    build_wide_world_1m_4c(ecs);
+    built = true;
+  }
+  run_wide_view_1m_4c(ecs);
+}
+
+BENCH(bench_backend_sparse_add_remove_churn) {
+  run_add_remove_churn<ECS>();
+}
+
+BENCH(bench_backend_archetype_add_remove_churn) {
+  run_add_remove_churn<ArchetypeECS>();
+}
@@ -1,8 +1,10 @@
 #pragma once
+#include "../engine/command_buffer.h"
 #include "../engine/ecs.h"
 #include "ecs_sample_components.h"
 #include "test_lib.h"
 
+#include <algorithm>
 #include <cassert>
 #include <random>
 #include <vector>
@@ -49,20 +51,27 @@ BENCH(bench_ecs_world_sim) {
   const size_t N = 200000;
 
   std::vector<Entity> ents(N);
-  for (size_t i = 0; i < N; i++)
+  for (size_t i = 0; i < N; i++) {
     ents[i] = ecs.create_entity();
+    ecs.add<Position>(ents[i], (float)i, (float)i);
+    if (i % 4 == 0)
+      ecs.add<Health>(ents[i], 100);
+  }
 
   std::mt19937 rng(999);
   std::uniform_int_distribution<int> dist(0, N - 1);
 
-  for (int frame = 0; frame < 2000; frame++) {
+  for (int frame = 0; frame < 200000; frame++) {
     int e = dist(rng);
     if (frame % 3 == 0)
       ecs.add<Velocity>(ents[e], 1.f, 2.f);
     else if (frame % 4 == 0 && ecs.has<Velocity>(ents[e]))
       ecs.remove<Velocity>(ents[e]);
-    else if (ecs.has<Position>(ents[e]))
+    else if (ecs.has<Position>(ents[e])) {
       ecs.get<Position>(ents[e]).x++;
+      if (ecs.has<Health>(ents[e]))
+        ecs.get<Health>(ents[e]).hp--;
+    }
   }
 }
 
@@ -95,6 +104,8 @@ BENCH(bench_ecs_cache_random) {
   for (size_t i = 0; i < N; i++) {
     ents[i] = ecs.create_entity();
     ecs.add<Position>(ents[i], (float)i, (float)i);
+    if (i % 2 == 0)
+      ecs.add<Velocity>(ents[i], 1.f, 1.f);
   }
 
   std::mt19937 rng(321);
@@ -103,5 +114,523 @@ BENCH(bench_ecs_cache_random) {
   for (Entity e : ents) {
     if (ecs.has<Position>(e))
       ecs.get<Position>(e).x++;
+    if (ecs.has<Velocity>(e))
+      ecs.get<Velocity>(e).vx++;
+    if (ecs.has<Health>(e))
+      ecs.get<Health>(e).hp--;
+  }
+}
+
+// bench_ecs_cache_random through for_each_of: one prefetched batch per
+// component instead of has + get per entity.
+BENCH(bench_ecs_cache_random_batch) {
+  ECS ecs;
+  const size_t N = 600000;
+
+  std::vector<Entity> ents(N);
+  for (size_t i = 0; i < N; i++) {
+    ents[i] = ecs.create_entity();
+    ecs.add<Position>(ents[i], (float)i, (float)i);
+    if (i % 2 == 0)
+      ecs.add<Velocity>(ents[i], 1.f, 1.f);
+  }
+
+  std::mt19937 rng(321);
+  std::shuffle(ents.begin(), ents.end(), rng);
+
+  ecs.for_each_of<Position>(ents, [](Entity, Position &p) { p.x++; });
+  ecs.for_each_of<Velocity>(ents, [](Entity, Velocity &v) { v.vx++; });
+  ecs.for_each_of<Health>(ents, [](Entity, Health &h) { h.hp--; });
+}
+
+BENCH(bench_ecs_multi_component_view_1m_4c) {
+  static ECS ecs;
+  static bool built = false;
+  const size_t N = 1000000;
+
+  // Build the world once; only the view passes are measured after warmup.
+  if (!built) {
+    for (size_t i = 0; i < N; i++) {
+      Entity e = ecs.create_entity();
+      ecs.add<Position>(e, (float)i, (float)i);
+      if (i % 2 == 0)
+        ecs.add<Velocity>(e, 1.f, 1.f);
+      if (i % 3 == 0)
+        ecs.add<Health>(e, 100);
+      if (i % 5 != 0)
+        ecs.add<Acceleration>(e, 0.5f, 0.5f);
+    }
+    built = true;
+  }
+
+  for (int frame = 0; frame < 10; frame++) {
+    ecs.view<Position, Velocity, Health, Acceleration>(
+        [&](Entity, Position &p, Velocity &v, Health &h, Acceleration &a) {
+          v.vx += a.ax;
+          p.x += v.vx;
+          h.hp -= 1;
+        });
+  }
+}
+
+// Many short passes over a small world: per-call setup dominates, which is
+// what a persistent query saves compared to a one-shot view.
+static ECS &small_world_for_repeated_views() {
+  static ECS ecs;
+  static bool built = false;
+  if (!built) {
+    for (size_t i = 0; i < 32; i++) {
+      Entity e = ecs.create_entity();
+      ecs.add<Position>(e, (float)i, (float)i);
+      ecs.add<Velocity>(e, 1.f, 1.f);
+      if (i % 2 == 0)
+        ecs.add<Health>(e, 100);
+    }
+    built = true;
+  }
+  return ecs;
+}
+
+BENCH(bench_ecs_view_repeated) {
+  ECS &ecs = small_world_for_repeated_views();
+  for (int frame = 0; frame < 100000; frame++)
+    ecs.view<Position, Velocity, Health>(
+        [&](Entity, Position &p, Velocity &v, Health &) { p.x += v.vx; });
+}
+
+BENCH(bench_ecs_query_repeated) {
+  ECS &ecs = small_world_for_repeated_views();
+  auto q = ecs.query<Position, Velocity, Health>();
+  for (int frame = 0; frame < 100000; frame++)
+    q.each([&](Entity, Position &p, Velocity &v, Health &) { p.x += v.vx; });
+}
+
+BENCH(bench_ecs_owning_group_1m_4c) {
+  static ECS ecs;
+  static bool built = false;
+  const size_t N = 1000000;
+
+  // Same world as bench_ecs_multi_component_view_1m_4c, iterated through an
+  // owning group instead of a view.
+  if (!built) {
+    for (size_t i = 0; i < N; i++) {
+      Entity e = ecs.create_entity();
+      ecs.add<Position>(e, (float)i, (float)i);
+      if (i % 2 == 0)
+        ecs.add<Velocity>(e, 1.f, 1.f);
+      if (i % 3 == 0)
+        ecs.add<Health>(e, 100);
+      if (i % 5 != 0)
+        ecs.add<Acceleration>(e, 0.5f, 0.5f);
+    }
+    ecs.owning_group<Position, Velocity, Health, Acceleration>();
+    built = true;
+  }
+
+  auto group = ecs.owning_group<Position, Velocity, Health, Acceleration>();
+  for (int frame = 0; frame < 10; frame++) {
+    group.each(
+        [&](Entity, Position &p, Velocity &v, Health &h, Acceleration &a) {
+          v.vx += a.ax;
+          p.x += v.vx;
+          h.hp -= 1;
+        });
+  }
+}
+
+// bench_ecs_multi_component_view's world, intersected repeatedly: a view
+// re-tests the mask of every Health entity, the non-owning group only walks
+// the matches.
+static ECS &multi_component_world() {
+  static ECS ecs;
+  static bool built = false;
+  if (!built) {
+    for (size_t i = 0; i < 400000; i++) {
+      Entity e = ecs.create_entity();
+      ecs.add<Position>(e, (float)i, (float)i);
+      if (i % 2 == 0)
+        ecs.add<Velocity>(e, 1.f, 1.f);
+      if (i % 3 == 0)
+        ecs.add<Health>(e, 100);
+    }
+    built = true;
+  }
+  return ecs;
+}
+
+BENCH(bench_ecs_multi_component_view_repeated) {
+  ECS &ecs = multi_component_world();
+  for (int frame = 0; frame < 10; frame++)
+    ecs.view<Position, Velocity, Health>(
+        [&](Entity, Position &p, Velocity &v, Health &h) {
+          p.x += v.vx;
+          h.hp -= 1;
+        });
+}
+
+// skip Health holders through the mask test ...
+BENCH(bench_ecs_view_exclude_repeated) {
+  ECS &ecs = multi_component_world();
+  for (int frame = 0; frame < 10; frame++)
+    ecs.view<Position, Velocity>(exclude<Health>,
+                                 [&](Entity, Position &p, Velocity &v) {
+                                   p.x += v.vx;
+                                 });
+}
+
+// ... and by branching in the callback
+BENCH(bench_ecs_view_exclude_in_callback_repeated) {
+  ECS &ecs = multi_component_world();
+  for (int frame = 0; frame < 10; frame++)
+    ecs.view<Position, Velocity>([&](Entity e, Position &p, Velocity &v) {
+      if (ecs.has<Health>(e))
+        return;
+      p.x += v.vx;
+    });
+}
+
+BENCH(bench_ecs_non_owning_group_repeated) {
+  ECS &ecs = multi_component_world();
+  auto group = ecs.non_owning_group<Position, Velocity, Health>();
+  for (int frame = 0; frame < 10; frame++)
+    group.each([&](Entity, Position &p, Velocity &v, Health &h) {
+      p.x += v.vx;
+      h.hp -= 1;
+    });
+}
+
+// bench_ecs_multi_component_view_repeated on 1..8 threads.
+template <size_t Threads> static void run_par_view_scaling() {
+  static JobSystem jobs(Threads);
+  ECS &ecs = multi_component_world();
+  for (int frame = 0; frame < 10; frame++)
+    ecs.par_view<Position, Velocity, Health>(
+        jobs, [&](Entity, Position &p, Velocity &v, Health &h) {
+          p.x += v.vx;
+          h.hp -= 1;
+        });
+}
+
+BENCH(bench_ecs_par_view_1_thread) { run_par_view_scaling<1>(); }
+BENCH(bench_ecs_par_view_2_threads) { run_par_view_scaling<2>(); }
+BENCH(bench_ecs_par_view_4_threads) { run_par_view_scaling<4>(); }
+BENCH(bench_ecs_par_view_8_threads) { run_par_view_scaling<8>(); }
+
+// Structural changes issued from a view over 200k entities: every entity
+// gets a Velocity, every 4th is destroyed, one new entity per 8 visited.
+static void fill_command_world(ECS &ecs) {
+  for (int i = 0; i < 200000; i++) {
+    Entity e = ecs.create_entity();
+    ecs.add<Position>(e, (float)i, 0.f);
+  }
+}
+
+BENCH(bench_ecs_command_buffer_apply) {
+  ECS ecs;
+  fill_command_world(ecs);
+  static CommandBuffer cmd; // chunks are kept between runs
+  ecs.view<Position>([&](Entity e, Position &p) {
+    cmd.add<Velocity>(e, p.x, 1.f);
+    int i = (int)p.x;
+    if (i % 4 == 0)
+      cmd.destroy(e);
+    if (i % 8 == 0)
+      cmd.add<Health>(cmd.create(), 100);
+  });
+  cmd.apply(ecs);
+}
+
+// Same changes with hand-rolled side vectors replayed after the view.
+BENCH(bench_ecs_command_side_vectors) {
+  ECS ecs;
+  fill_command_world(ecs);
+  std::vector<std::pair<Entity, Velocity>> adds;
+  std::vector<Entity> destroys;
+  size_t creates = 0;
+  ecs.view<Position>([&](Entity e, Position &p) {
+    adds.push_back({e, Velocity{p.x, 1.f}});
+    int i = (int)p.x;
+    if (i % 4 == 0)
+      destroys.push_back(e);
+    if (i % 8 == 0)
+      creates++;
+  });
+  for (size_t i = 0; i < creates; i++)
+    ecs.add<Health>(ecs.create_entity(), 100);
+  for (auto &a : adds)
+    ecs.add<Velocity>(a.first, a.second);
+  for (Entity e : destroys)
+    ecs.destroy_entity(e);
+}
+
+// Conway grid startup (639 x 359 cells) with a raylib-free stand-in for
+// CellComponent: per-entity create/add vs create_entities + add_bulk.
+struct ConwayCell {
+  float x, y, w, h;
+  uint8_t r, g, b, a;
+};
+static const int CONWAY_W = 639;
+static const int CONWAY_H = 359;
+
+static ConwayCell conway_cell(int i) {
+  uint8_t c = (i * 2654435761u) >> 31 ? 255 : 0;
+  return {float(i % CONWAY_W), float(i / CONWAY_W), 1.f, 1.f, c, c, c, 255};
+}
+
+BENCH(bench_ecs_conway_startup_per_entity) {
+  ECS ecs;
+  std::vector<Entity> grid(CONWAY_W * CONWAY_H);
+  for (int i = 0; i < CONWAY_W * CONWAY_H; i++) {
+    Entity e = ecs.create_entity();
+    ecs.add<ConwayCell>(e, conway_cell(i));
+    grid[i] = e;
+  }
+}
+
+BENCH(bench_ecs_conway_startup_bulk) {
+  ECS ecs;
+  std::vector<Entity> grid(CONWAY_W * CONWAY_H);
+  std::vector<ConwayCell> cells(grid.size());
+  for (int i = 0; i < CONWAY_W * CONWAY_H; i++)
+    cells[i] = conway_cell(i);
+  ecs.create_entities(grid.size(), grid.data());
+  ecs.add_bulk<ConwayCell>(grid, cells);
+}
+
+// Destroying 100k entities (2 components each, random order) in a world
+// with 48 registered component types.
+template <int N> struct BenchTag {
+  int value;
+};
+
+template <typename World, int... Ns>
+static void register_bench_types(World &ecs,
+                                 std::integer_sequence<int, Ns...>) {
+  (ecs.template component_id<BenchTag<Ns>>(), ...);
+}
+
+static std::vector<Entity> wide_world(ECS &ecs) {
+  register_bench_types(ecs, std::make_integer_sequence<int, 48>{});
+  std::vector<Entity> ents(100000);
+  ecs.create_entities(ents.size(), ents.data());
+  for (Entity e : ents) {
+    ecs.add<Position>(e, 0.f, 0.f);
+    ecs.add<Velocity>(e, 0.f, 0.f);
+  }
+  std::mt19937 rng(42);
+  std::shuffle(ents.begin(), ents.end(), rng);
+  return ents;
+}
+
+BENCH(bench_ecs_destroy_wide_world) {
+  ECS ecs;
+  std::vector<Entity> ents = wide_world(ecs);
+  for (Entity e : ents)
+    ecs.destroy_entity(e);
+}
+
+BENCH(bench_ecs_destroy_entities_wide_world) {
+  ECS ecs;
+  std::vector<Entity> ents = wide_world(ecs);
+  ecs.destroy_entities(ents);
+}
+
+// Random has/get mix over 200k entities, a third of which have Velocity:
+// 1M random probes, reading Velocity where present.
+static const std::vector<Entity> &random_probe_world(ECS *&out) {
+  static ECS ecs;
+  static std::vector<Entity> probes;
+  if (probes.empty()) {
+    std::vector<Entity> ents(200000);
+    ecs.create_entities(ents.size(), ents.data());
+    for (size_t i = 0; i < ents.size(); i++) {
+      ecs.add<Position>(ents[i], (float)i, 0.f);
+      if (i % 3 == 0)
+        ecs.add<Velocity>(ents[i], 1.f, 0.f);
+    }
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<size_t> pick(0, ents.size() - 1);
+    for (int i = 0; i < 1000000; i++)
+      probes.push_back(ents[pick(rng)]);
   }
+  out = &ecs;
+  return probes;
+}
+
+BENCH(bench_ecs_random_has_get) {
+  ECS *ecs;
+  const auto &probes = random_probe_world(ecs);
+  float sum = 0;
+  for (Entity e : probes)
+    if (ecs->has<Velocity>(e))
+      sum += ecs->get<Velocity>(e).vx + ecs->get<Position>(e).x;
+  assert(sum > 0);
+}
+
+BENCH(bench_ecs_random_has_storage_unchecked) {
+  ECS *ecs;
+  const auto &probes = random_probe_world(ecs);
+  auto vel = ecs->storage<Velocity>();
+  auto pos = ecs->storage<Position>();
+  float sum = 0;
+  for (Entity e : probes)
+    if (ecs->has<Velocity>(e))
+      sum += vel.get_unchecked(e.index).vx + pos.get_unchecked(e.index).x;
+  assert(sum > 0);
+}
+
+// Dynamic vs fixed-width masks: register 96 component types in a world of
+// 200k entities (dynamic re-lays out every mask when crossing 64), then
+// test a two-type group against every entity.
+template <typename World> static void run_wide_mask_world() {
+  World ecs;
+  std::vector<Entity> ents(200000);
+  ecs.create_entities(ents.size(), ents.data());
+  ecs.template add<Position>(ents[0], 0.f, 0.f);
+  register_bench_types(ecs, std::make_integer_sequence<int, 94>{});
+  for (size_t i = 0; i < ents.size(); i += 2)
+    ecs.template add<BenchTag<90>>(ents[i], 1);
+  auto grp = ecs.template create_group<Position, BenchTag<90>>();
+  size_t matched = 0;
+  for (int round = 0; round < 10; round++)
+    for (Entity e : ents)
+      matched += ecs.matches_group(e, grp);
+  assert(matched == 10);
+}
+
+BENCH(bench_ecs_wide_masks_dynamic) { run_wide_mask_world<ECS>(); }
+BENCH(bench_ecs_wide_masks_fixed_128) { run_wide_mask_world<BasicECS<128>>(); }
+
+// 1M entities; Position and Velocity have 500k holders each (Position added
+// in shuffled order) but only 1% of the driving storage has both, so views
+// spend their time rejecting scattered candidates.
+static ECS &sparse_match_world() {
+  static ECS ecs;
+  static bool built = false;
+  if (!built) {
+    built = true;
+    std::vector<Entity> ents(1000000);
+    ecs.create_entities(ents.size(), ents.data());
+    std::vector<size_t> order(ents.size() / 2);
+    for (size_t i = 0; i < order.size(); i++)
+      order[i] = i;
+    std::shuffle(order.begin(), order.end(), std::mt19937(11));
+    for (size_t i : order) {
+      ecs.add<Position>(ents[i], (float)i, 0.f);
+      if (i % 100 == 0)
+        ecs.add<Velocity>(ents[i], 1.f, 0.f);
+    }
+    for (size_t i = ents.size() / 2; ecs.storage<Velocity>().size() < 500000;
+         i++)
+      ecs.add<Velocity>(ents[i], 1.f, 0.f);
+  }
+  return ecs;
+}
+
+BENCH(bench_ecs_view_1pct_match) {
+  ECS &ecs = sparse_match_world();
+  size_t matched = 0;
+  for (int rep = 0; rep < 10; rep++)
+    ecs.view<Position, Velocity>([&](Entity, Position &p, Velocity &v) {
+      p.x += v.vx;
+      matched++;
+    });
+  assert(matched == 10 * 5000);
+}
+
+// Tag-heavy frame: mark and unmark every entity with two marker types,
+// then visit the marked ones.
+struct BenchMarked {};
+struct BenchVisible {};
+
+BENCH(bench_ecs_tag_add_remove) {
+  static ECS ecs;
+  static std::vector<Entity> ents;
+  if (ents.empty()) {
+    ents.resize(500000);
+    ecs.create_entities(ents.size(), ents.data());
+    for (Entity e : ents)
+      ecs.add<Position>(e, 1.f, 1.f);
+  }
+  for (int rep = 0; rep < 2; rep++) {
+    for (size_t i = 0; i < ents.size(); i++) {
+      ecs.add<BenchMarked>(ents[i]);
+      if (i % 2 == 0)
+        ecs.add<BenchVisible>(ents[i]);
+    }
+    size_t visited = 0;
+    ecs.view<Position, BenchMarked, BenchVisible>(
+        [&](Entity, Position &p) {
+          p.x += 1.f;
+          visited++;
+        });
+    assert(visited == ents.size() / 2);
+    for (Entity e : ents) {
+      ecs.remove<BenchMarked>(e);
+      ecs.remove<BenchVisible>(e);
+    }
+  }
+}
+
+// Conway-sized world (229k cells) where a frame touches 1% of them: a
+// Changed<T> query visits the delta instead of the whole storage.
+BENCH(bench_ecs_changed_query_small_delta) {
+  static ECS ecs;
+  static std::vector<Entity> ents;
+  static auto changed = ecs.query<const Position, Changed<Position>>();
+  if (ents.empty()) {
+    ents.resize(229000);
+    ecs.create_entities(ents.size(), ents.data());
+    for (Entity e : ents)
+      ecs.add<Position>(e, 1.f, 1.f);
+    changed.each([](Entity, const Position &) {});
+  }
+  std::mt19937 rng(3);
+  for (int frame = 0; frame < 100; frame++) {
+    for (int i = 0; i < 2290; i++)
+      ecs.get<Position>(ents[rng() % ents.size()]).x += 1.f;
+    size_t visited = 0;
+    changed.each([&](Entity, const Position &) { visited++; });
+    assert(visited > 0 && visited <= 2290);
+  }
+}
+
+BENCH(bench_ecs_full_scan_same_world) {
+  static ECS ecs;
+  static std::vector<Entity> ents;
+  if (ents.empty()) {
+    ents.resize(229000);
+    ecs.create_entities(ents.size(), ents.data());
+    for (Entity e : ents)
+      ecs.add<Position>(e, 1.f, 1.f);
+  }
+  std::mt19937 rng(3);
+  for (int frame = 0; frame < 100; frame++) {
+    for (int i = 0; i < 2290; i++)
+      ecs.get<Position>(ents[rng() % ents.size()]).x += 1.f;
+    float sum = 0;
+    ecs.view<Position>([&](Entity, Position &p) { sum += p.x; });
+    assert(sum > 0);
+  }
+}
+
+// Components that own heap memory: add builds them in place and
+// swap-remove moves them, so no operation allocates or copies a vector.
+struct BenchPath {
+  std::vector<float> points;
+};
+
+BENCH(bench_ecs_add_remove_vector_component) {
+  ECS ecs;
+  const size_t N = 200000;
+  std::vector<Entity> ents(N);
+  ecs.create_entities(N, ents.data());
+  for (size_t i = 0; i < N; i++)
+    ecs.add<BenchPath>(ents[i], std::vector<float>(32, (float)i));
+  for (size_t i = 0; i < N; i += 2)
+    ecs.remove<BenchPath>(ents[i]);
+  for (size_t i = 0; i < N; i += 2)
+    ecs.add<BenchPath>(ents[i], std::vector<float>(32, 1.f));
+  for (size_t i = 1; i < N; i += 2)
+    ecs.replace<BenchPath>(ents[i], std::vector<float>(32, 2.f));
 }
@@ -0,0 +1,123 @@
+#pragma once
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "../engine/job_system.h"
+#include "../engine/scheduler.h"
+#include "ecs_sample_components.h"
+#include "test_lib.h"
+
+// ------------------------------------------------------------
+// BENCHMARKS
+// ------------------------------------------------------------
+// Steal statistics are printed once per benchmark (first call).
+static void print_steal_rate(JobSystem &jobs, bool &printed) {
+  if (printed)
+    return;
+  printed = true;
+  JobSystem::Stats s = jobs.stats();
+  double rate = s.executed ? 100.0 * double(s.stolen) / double(s.executed) : 0;
+  std::cout << "  jobs: " << s.executed << ", stolen: " << s.stolen << " ("
+            << rate << "%)\n";
+}
+
+// 100k empty jobs spawned from one thread, then waited on.
+BENCH(bench_jobs_spawn_overhead) {
+  static JobSystem jobs;
+  static bool printed = false;
+  jobs.reset_stats();
+  JobSystem::Counter counter;
+  for (int i = 0; i < 100000; i++)
+    jobs.spawn([] {}, &counter);
+  jobs.wait(counter);
+  print_steal_rate(jobs, printed);
+}
+
+// Fine-grained: 4M cheap items in chunks of 256.
+template <size_t Threads> static void run_jobs_fine() {
+  static JobSystem jobs(Threads);
+  static std::vector<float> data(4'000'000, 1.f);
+  static bool printed = false;
+  jobs.reset_stats();
+  jobs.parallel_for(data.size(), 256, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++)
+      data[i] = data[i] * 0.5f + 1.f;
+  });
+  print_steal_rate(jobs, printed);
+}
+
+// Coarse: 64 heavy items, one per job.
+template <size_t Threads> static void run_jobs_coarse() {
+  static JobSystem jobs(Threads);
+  static std::vector<double> out(64);
+  static bool printed = false;
+  jobs.reset_stats();
+  jobs.parallel_for(out.size(), 1, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      double acc = 0;
+      for (int k = 1; k < 20000; k++)
+        acc += std::sqrt(double(k + i));
+      out[i] = acc;
+    }
+  });
+  print_steal_rate(jobs, printed);
+}
+
+BENCH(bench_jobs_fine_1_thread) { run_jobs_fine<1>(); }
+BENCH(bench_jobs_fine_2_threads) { run_jobs_fine<2>(); }
+BENCH(bench_jobs_fine_4_threads) { run_jobs_fine<4>(); }
+BENCH(bench_jobs_fine_8_threads) { run_jobs_fine<8>(); }
+
+BENCH(bench_jobs_coarse_1_thread) { run_jobs_coarse<1>(); }
+BENCH(bench_jobs_coarse_2_threads) { run_jobs_coarse<2>(); }
+BENCH(bench_jobs_coarse_4_threads) { run_jobs_coarse<4>(); }
+BENCH(bench_jobs_coarse_8_threads) { run_jobs_coarse<8>(); }
+
+// One frame of 8 systems: 4 independent pairs of writer -> reader, each
+// touching 50k components. Measures graph dispatch on top of the work.
+BENCH(bench_jobs_scheduler_frame) {
+  static JobSystem jobs(4);
+  static ECS ecs;
+  static Scheduler sched;
+  static bool init = false;
+  if (!init) {
+    init = true;
+    for (int i = 0; i < 50000; i++) {
+      Entity e = ecs.create_entity();
+      ecs.add<Position>(e, 0.f, 0.f);
+      ecs.add<Velocity>(e, 1.f, 1.f);
+      ecs.add<Health>(e, 100);
+      ecs.add<Acceleration>(e, 0.f, 0.f);
+    }
+    sched.add("pos", Reads<>{}, Writes<Position>{}, [](ECS &w, float dt) {
+      w.view<Position>([&](Entity, Position &p) { p.x += dt; });
+    });
+    sched.add("vel", Reads<>{}, Writes<Velocity>{}, [](ECS &w, float dt) {
+      w.view<Velocity>([&](Entity, Velocity &v) { v.vx += dt; });
+    });
+    sched.add("hp", Reads<>{}, Writes<Health>{}, [](ECS &w, float) {
+      w.view<Health>([&](Entity, Health &h) { h.hp += 1; });
+    });
+    sched.add("acc", Reads<>{}, Writes<Acceleration>{}, [](ECS &w, float dt) {
+      w.view<Acceleration>([&](Entity, Acceleration &a) { a.ax += dt; });
+    });
+    static volatile float sink = 0;
+    sched.add("read_pos", Reads<Position>{}, Writes<>{}, [](ECS &w, float) {
+      w.view<Position>([&](Entity, Position &p) { sink = sink + p.x; });
+    });
+    sched.add("read_vel", Reads<Velocity>{}, Writes<>{}, [](ECS &w, float) {
+      w.view<Velocity>([&](Entity, Velocity &v) { sink = sink + v.vx; });
+    });
+    sched.add("read_hp", Reads<Health>{}, Writes<>{}, [](ECS &w, float) {
+      w.view<Health>([&](Entity, Health &h) { sink = sink + h.hp; });
+    });
+    sched.add("read_acc", Reads<Acceleration>{}, Writes<>{},
+              [](ECS &w, float) {
+                w.view<Acceleration>(
+                    [&](Entity, Acceleration &a) { sink = sink + a.ax; });
+              });
+  }
+  sched.run(ecs, 0.001f, jobs);
+}
@@ -45,6 +45,35 @@ BENCH(bench_sparse_lookup) {
   (void)sink;
 }
 
+// bench_sparse_lookup through get_batch: slots, dense entries and values
+// of upcoming keys are prefetched while the current ones are summed.
+BENCH(bench_sparse_lookup_batch) {
+  const int N = 10'000'000;
+  SparseSet<uint32_t, uint32_t> s;
+  for (int i = 0; i < N; i++)
+    s.insert(i, i + 1);
+
+  std::vector<uint32_t> keys(N);
+  for (int i = 0; i < N; i++)
+    keys[i] = i;
+
+  std::mt19937 rng(123);
+  std::shuffle(keys.begin(), keys.end(), rng);
+
+  constexpr size_t CHUNK = 1024;
+  uint32_t *out[CHUNK];
+  uint64_t sum = 0;
+  for (size_t base = 0; base < keys.size(); base += CHUNK) {
+    const size_t n = std::min(CHUNK, keys.size() - base);
+    s.get_batch(Span<const uint32_t>(keys.data() + base, n), out);
+    for (size_t i = 0; i < n; i++)
+      sum += *out[i];
+  }
+
+  volatile uint64_t sink = sum;
+  (void)sink;
+}
+
 BENCH(bench_sparse_iteration) {
   const int N = 10'000'000;
   SparseSet<uint32_t, uint32_t> s;
@@ -94,3 +123,156 @@ BENCH(bench_sparse_random_insert_erase) {
   for (int i = 0; i < OPS; i++)
     s.erase(keys[i]);
 }
+
+// Same as bench_sparse_insert/iteration with 4096-element component pages:
+// growth allocates a page instead of reallocating and copying everything.
+using BenchPagedSet = PagedSet<uint32_t, uint32_t, 4096, false>;
+
+BENCH(bench_sparse_insert_paged) {
+  const int N = 10'000'000;
+  std::vector<uint32_t> keys(N);
+  for (int i = 0; i < N; i++)
+    keys[i] = i;
+
+  std::mt19937 rng(123);
+  std::shuffle(keys.begin(), keys.end(), rng);
+
+  BenchPagedSet s;
+  for (uint32_t k : keys)
+    s.insert(k, k + 1);
+}
+
+BENCH(bench_sparse_iteration_paged) {
+  const int N = 10'000'000;
+  BenchPagedSet s;
+  for (int i = 0; i < N; i++)
+    s.insert(i, i + 1);
+
+  uint64_t sum = 0;
+  s.for_each([&](uint32_t, uint32_t &v) { sum += v; });
+
+  volatile uint64_t sink = sum;
+  (void)sink;
+}
+
+#ifdef RECS_MAPPED_SPARSE
+// bench_sparse_insert/lookup with the mmap-backed sparse table: no page
+// pointer to load and no INVALID fill when a page is first touched.
+using BenchMappedSet =
+    SparseSet<uint32_t, uint32_t, MappedEntitySet<uint32_t>>;
+
+BENCH(bench_sparse_insert_mapped) {
+  const int N = 10'000'000;
+  std::vector<uint32_t> keys(N);
+  for (int i = 0; i < N; i++)
+    keys[i] = i;
+
+  std::mt19937 rng(123);
+  std::shuffle(keys.begin(), keys.end(), rng);
+
+  BenchMappedSet s;
+  for (uint32_t k : keys)
+    s.insert(k, k + 1);
+}
+
+BENCH(bench_sparse_lookup_mapped) {
+  const int N = 10'000'000;
+  BenchMappedSet s;
+  for (int i = 0; i < N; i++)
+    s.insert(i, i + 1);
+
+  std::vector<uint32_t> keys(N);
+  for (int i = 0; i < N; i++)
+    keys[i] = i;
+
+  std::mt19937 rng(123);
+  std::shuffle(keys.begin(), keys.end(), rng);
+
+  uint64_t sum = 0;
+  for (uint32_t k : keys)
+    sum += s.get(k);
+
+  volatile uint64_t sink = sum;
+  (void)sink;
+}
+
+// Ids scattered over most of the 32-bit range, 65536 apart: one entity
+// per sparse page, so the paged table allocates and fills a page for every
+// insert while the mapped one only faults in a zero page.
+static std::vector<uint32_t> scattered_keys(int n) {
+  std::vector<uint32_t> keys(n);
+  std::mt19937 rng(123);
+  for (int i = 0; i < n; i++)
+    keys[i] = (uint32_t(i) << 16) | (rng() & 0xFFFF);
+  std::shuffle(keys.begin(), keys.end(), rng);
+  return keys;
+}
+
+BENCH(bench_sparse_insert_scattered) {
+  const auto keys = scattered_keys(50'000);
+  SparseSet<uint32_t, uint32_t> s;
+  for (uint32_t k : keys)
+    s.insert(k, k + 1);
+}
+
+BENCH(bench_sparse_insert_scattered_mapped) {
+  const auto keys = scattered_keys(50'000);
+  BenchMappedSet s;
+  for (uint32_t k : keys)
+    s.insert(k, k + 1);
+}
+#endif
+
+// Bulk membership, index translation and intersection: the SIMD kernels
+// of sparse_filter.h against a scalar contains() / index_of() loop, over
+// 10M shuffled ids of which half are in the set.
+struct BenchBulkSets {
+  SparseSet<uint32_t, uint32_t> half; // even ids below 2N
+  std::vector<uint32_t> keys;         // 0 .. N-1, shuffled
+  std::vector<uint32_t> out;
+
+  BenchBulkSets() {
+    const uint32_t N = 10'000'000;
+    for (uint32_t i = 0; i < N; i += 2)
+      half.insert(i, i);
+    keys.resize(N);
+    for (uint32_t i = 0; i < N; i++)
+      keys[i] = i;
+    std::mt19937 rng(123);
+    std::shuffle(keys.begin(), keys.end(), rng);
+    out.resize(N);
+  }
+
+  static BenchBulkSets &get() {
+    static BenchBulkSets sets;
+    return sets;
+  }
+};
+
+BENCH(bench_sparse_index_of_scalar) {
+  auto &b = BenchBulkSets::get();
+  for (size_t i = 0; i < b.keys.size(); i++)
+    b.out[i] = b.half.contains(b.keys[i]) ? b.half.index_of(b.keys[i])
+                                          : SparseSet<uint32_t>::INVALID;
+}
+
+BENCH(bench_sparse_index_of_many) {
+  auto &b = BenchBulkSets::get();
+  b.half.index_of_many(b.keys, b.out.data());
+}
+
+BENCH(bench_sparse_filter_scalar) {
+  auto &b = BenchBulkSets::get();
+  size_t count = 0;
+  for (uint32_t k : b.keys)
+    if (b.half.contains(k))
+      b.out[count++] = k;
+  volatile size_t sink = count;
+  (void)sink;
+}
+
+BENCH(bench_sparse_filter) {
+  auto &b = BenchBulkSets::get();
+  volatile size_t sink = b.half.filter(b.keys, b.out.data());
+  (void)sink;
+}
@@ -9,3 +9,6 @@ struct Velocity {
 struct Health {
   int hp;
 };
+struct Acceleration {
+  float ax, ay;
+};
@@ -0,0 +1,114 @@
+#pragma once
+#include "../engine/archetype.h"
+#include "ecs_sample_components.h"
+#include "test_lib.h"
+
+#include <cassert>
+#include <string>
+#include <vector>
+
+// ------------------------------------------------------------
+// TESTS
+// ------------------------------------------------------------
+TEST(test_archetype_basic) {
+  ArchetypeECS ecs;
+
+  Entity e1 = ecs.create_entity();
+  Entity e2 = ecs.create_entity();
+  Entity e3 = ecs.create_entity();
+
+  ecs.add<Position>(e1, 1.f, 2.f);
+  ecs.add<Velocity>(e1, 0.1f, 0.2f);
+
+  ecs.add<Position>(e2, 10.f, 20.f);
+
+  ecs.add<Position>(e3, -1.f, -2.f);
+  ecs.add<Velocity>(e3, 5.f, 6.f);
+  ecs.add<Health>(e3, 50);
+
+  assert(ecs.has<Position>(e1));
+  assert(!ecs.has<Health>(e1));
+
+  assert(ecs.get<Position>(e1).x == 1);
+  assert(ecs.get<Velocity>(e3).vx == 5);
+
+  // moving e1 to {Position} must keep e3's row intact
+  ecs.remove<Velocity>(e1);
+  assert(!ecs.has<Velocity>(e1));
+  assert(ecs.get<Position>(e1).y == 2);
+  assert(ecs.get<Health>(e3).hp == 50);
+
+  ecs.destroy_entity(e2);
+  assert(!ecs.is_alive(e2));
+  assert(ecs.get<Position>(e1).x == 1 && ecs.get<Position>(e3).x == -1);
+}
+
+TEST(test_archetype_view) {
+  ArchetypeECS ecs;
+  std::vector<Entity> ents;
+  for (int i = 0; i < 5000; i++) {
+    Entity e = ecs.create_entity();
+    ecs.add<Position>(e, float(i), 0.f);
+    if (i % 2 == 0)
+      ecs.add<Velocity>(e, float(i), 0.f);
+    if (i % 3 == 0)
+      ecs.add<Health>(e, i);
+    ents.push_back(e);
+  }
+  for (int i = 0; i < 5000; i += 10)
+    ecs.destroy_entity(ents[i]);
+
+  int count_pos = 0;
+  ecs.view<Position>([&](Entity, Position &) { count_pos++; });
+  assert(count_pos == 4500);
+
+  // spans the {P,V,H} archetype only; several chunks
+  int count = 0;
+  ecs.view<Health, Velocity>([&](Entity e, Health &h, Velocity &v) {
+    assert(h.hp == int(e.index) && v.vx == float(e.index));
+    count++;
+  });
+  assert(count == 667);
+  assert(ecs.archetype_count() == 5); // {}, P, PV, PH, PVH
+}
+
+TEST(test_archetype_nontrivial_components) {
+  // Components with heap state must survive every row move.
+  ArchetypeECS ecs;
+  std::vector<Entity> ents;
+  for (int i = 0; i < 100; i++) {
+    Entity e = ecs.create_entity();
+    ecs.add<std::string>(e, std::string(40, char('a' + i % 26)));
+    ents.push_back(e);
+  }
+  for (int i = 0; i < 100; i += 3)
+    ecs.add<Health>(ents[i], i);
+  for (int i = 0; i < 100; i += 2)
+    ecs.destroy_entity(ents[i]);
+  for (int i = 1; i < 100; i += 2) {
+    assert(ecs.get<std::string>(ents[i]) ==
+           std::string(40, char('a' + i % 26)));
+  }
+}
+
+TEST(test_archetype_add_aliases_own_component) {
+  ArchetypeECS ecs;
+  Entity a = ecs.create_entity();
+  Entity b = ecs.create_entity();
+  ecs.add<Position>(a, 1.f, 2.f);
+  ecs.add<Position>(b, 3.f, 4.f);
+
+  // a's row is swap-filled by b when a moves to {P,V}; the arguments
+  // still have to read a's position
+  ecs.add<Velocity>(a, ecs.get<Position>(a).x, ecs.get<Position>(a).y);
+  assert(ecs.get<Velocity>(a).vx == 1.f && ecs.get<Velocity>(a).vy == 2.f);
+  assert(ecs.get<Position>(b).x == 3.f);
+
+  // overwrite path: reads a's velocity while assigning it
+  ecs.add<Velocity>(a, ecs.get<Velocity>(a).vy, ecs.get<Velocity>(a).vx);
+  assert(ecs.get<Velocity>(a).vx == 2.f && ecs.get<Velocity>(a).vy == 1.f);
+
+  // T(args...) is used when T has that constructor
+  ecs.add<std::string>(b, size_t(3), 'z');
+  assert(ecs.get<std::string>(b) == "zzz");
+}
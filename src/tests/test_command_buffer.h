@@ -0,0 +1,278 @@
+#pragma once
+#include "../engine/command_buffer.h"
+#include "ecs_sample_components.h"
+#include "test_lib.h"
+
+#include <atomic>
+#include <cassert>
+#include <string>
+#include <vector>
+
+// ------------------------------------------------------------
+// TESTS
+// ------------------------------------------------------------
+TEST(test_command_buffer_structural_changes_in_view) {
+  ECS ecs;
+  std::vector<Entity> ents;
+  for (int i = 0; i < 1000; i++) {
+    Entity e = ecs.create_entity();
+    ecs.add<Position>(e, (float)i, 0.f);
+    ents.push_back(e);
+  }
+
+  CommandBuffer cmd;
+  int visited = 0;
+  ecs.view<Position>([&](Entity e, Position &p) {
+    visited++;
+    int i = (int)p.x;
+    if (i % 3 == 0)
+      cmd.destroy(e);
+    else if (i % 3 == 1)
+      cmd.add<Velocity>(e, p.x, 1.f);
+    else
+      cmd.remove<Position>(e);
+  });
+  assert(visited == 1000);
+  assert(cmd.size() == 1000);
+
+  // nothing happened yet
+  for (Entity e : ents)
+    assert(ecs.is_alive(e) && ecs.has<Position>(e));
+
+  cmd.apply(ecs);
+  assert(cmd.empty() && cmd.bytes() == 0);
+  for (int i = 0; i < 1000; i++) {
+    Entity e = ents[i];
+    if (i % 3 == 0) {
+      assert(!ecs.is_alive(e));
+    } else if (i % 3 == 1) {
+      assert(ecs.has<Position>(e) && ecs.has<Velocity>(e));
+      assert(ecs.get<Velocity>(e).vx == (float)i);
+    } else {
+      assert(ecs.is_alive(e) && !ecs.has<Position>(e));
+    }
+  }
+}
+
+TEST(test_command_buffer_deferred_create_and_order) {
+  ECS ecs;
+  Entity existing = ecs.create_entity();
+  ecs.add<Health>(existing, 5);
+
+  CommandBuffer cmd;
+  Entity a = cmd.create();
+  Entity b = cmd.create();
+  assert(a.version == CommandBuffer::DEFERRED_VERSION);
+  assert(!ecs.is_alive(a));
+
+  cmd.add<Position>(a, 1.f, 2.f);
+  cmd.add<Health>(a, 10);
+  cmd.add<Position>(b, 3.f, 4.f);
+  // same type keeps recorded order: add then remove -> removed
+  cmd.add<Velocity>(b, 1.f, 1.f);
+  cmd.remove<Velocity>(b);
+  // remove then add -> present with the new value
+  cmd.remove<Health>(existing);
+  cmd.add<Health>(existing, 42);
+  // destroys run last, after the adds for the same entity
+  Entity doomed = cmd.create();
+  cmd.add<Position>(doomed, 0.f, 0.f);
+  cmd.destroy(doomed);
+  assert(cmd.pending_creates() == 3);
+
+  cmd.apply(ecs);
+
+  int with_pos = 0;
+  ecs.view<Position>([&](Entity, Position &) { with_pos++; });
+  assert(with_pos == 2);
+  int with_vel = 0;
+  ecs.view<Velocity>([&](Entity, Velocity &) { with_vel++; });
+  assert(with_vel == 0);
+  assert(ecs.get<Health>(existing).hp == 42);
+
+  // created entities reuse the freed slot afterwards
+  int healthy = 0;
+  ecs.view<Position, Health>([&](Entity, Position &p, Health &h) {
+    assert(p.x == 1.f && h.hp == 10);
+    healthy++;
+  });
+  assert(healthy == 1);
+}
+
+TEST(test_command_buffer_payload_lifetime) {
+  struct Name {
+    std::string value;
+  };
+  ECS ecs;
+  Entity e = ecs.create_entity();
+
+  {
+    CommandBuffer dropped;
+    // long enough to live on the heap; leaks show up under sanitizers
+    dropped.add<Name>(e, std::string(100, 'x'));
+    dropped.clear();
+    assert(dropped.empty());
+    dropped.add<Name>(e, std::string(100, 'y'));
+  } // destructor drops the unapplied payload
+
+  CommandBuffer cmd;
+  // large payloads get a chunk of their own
+  struct Big {
+    char bytes[64 * 1024];
+  };
+  Entity big = cmd.create();
+  cmd.add<Big>(big);
+  for (int i = 0; i < 2000; i++)
+    cmd.add<Name>(e, std::to_string(i));
+  cmd.apply(ecs);
+  assert(ecs.get<Name>(e).value == "1999");
+  int bigs = 0;
+  ecs.view<Big>([&](Entity, Big &) { bigs++; });
+  assert(bigs == 1);
+
+  // over-aligned payloads are aligned in the arena, wherever the record
+  // lands after the previous ones
+  struct alignas(32) Wide {
+    float lanes[8];
+  };
+  for (int i = 0; i < 600; i++) {
+    cmd.add<Health>(e, i); // shifts the next record by a header
+    cmd.add<Wide>(cmd.create(), Wide{{float(i)}});
+  }
+  cmd.apply(ecs);
+  int wides = 0;
+  ecs.view<Wide>([&](Entity, Wide &w) {
+    assert(reinterpret_cast<uintptr_t>(&w) % alignof(Wide) == 0);
+    assert(w.lanes[0] >= 0.f && w.lanes[0] < 600.f);
+    wides++;
+  });
+  assert(wides == 600);
+}
+
+TEST(test_command_buffer_add_matches_ecs_add) {
+  ECS ecs;
+  Entity now = ecs.create_entity();
+  Entity later = ecs.create_entity();
+
+  // constructor arguments, not an initializer list: "zzz" either way
+  ecs.add<std::string>(now, size_t(3), 'z');
+  CommandBuffer cmd;
+  cmd.add<std::string>(later, size_t(3), 'z');
+  cmd.add<Position>(later, 1.f, 2.f); // aggregates still use braces
+  cmd.apply(ecs);
+
+  assert(ecs.get<std::string>(now) == "zzz");
+  assert(ecs.get<std::string>(later) == ecs.get<std::string>(now));
+  assert(ecs.get<Position>(later).y == 2.f);
+}
+
+TEST(test_command_buffer_merge) {
+  ECS ecs;
+  CommandBuffer a, b;
+
+  Entity a0 = a.create();
+  a.add<Health>(a0, 1);
+  Entity b0 = b.create();
+  Entity b1 = b.create();
+  b.add<Health>(b0, 2);
+  b.add<Health>(b1, 3);
+  Entity a1 = a.create();
+  a.add<Health>(a1, 4);
+
+  a.merge(b);
+  assert(b.empty());
+  assert(a.size() == 4 && a.pending_creates() == 4);
+  // records after the merge still resolve to a's own handles
+  Entity a2 = a.create();
+  a.add<Health>(a2, 5);
+  a.apply(ecs);
+
+  std::vector<int> hp;
+  ecs.view<Health>([&](Entity, Health &h) { hp.push_back(h.hp); });
+  std::sort(hp.begin(), hp.end());
+  assert((hp == std::vector<int>{1, 2, 3, 4, 5}));
+}
+
+TEST(test_command_buffer_fixed_mask_world) {
+  BasicECS<64> ecs;
+  Entity keep = ecs.create_entity();
+  Entity gone = ecs.create_entity();
+  ecs.add<Position>(keep, 1.f, 2.f);
+  ecs.add<Position>(gone, 3.f, 4.f);
+
+  BasicCommandBuffer<64> cmd;
+  Entity spawned = cmd.create();
+  cmd.add<Health>(spawned, 9);
+  cmd.add<Velocity>(keep, 5.f, 6.f);
+  cmd.remove<Position>(keep);
+  cmd.destroy(gone);
+  cmd.apply(ecs);
+
+  assert(cmd.empty() && !ecs.is_alive(gone));
+  assert(ecs.has<Velocity>(keep) && !ecs.has<Position>(keep));
+  assert(ecs.get<Velocity>(keep).vx == 5.f);
+  int hp = 0;
+  ecs.view<Health>([&](Entity, Health &h) { hp += h.hp; });
+  assert(hp == 9);
+}
+
+TEST(test_command_buffers_par_view) {
+  ECS ecs;
+  JobSystem jobs(4);
+  for (int i = 0; i < 20000; i++) {
+    Entity e = ecs.create_entity();
+    ecs.add<Position>(e, (float)i, 0.f);
+  }
+
+  CommandBuffers cmds(jobs);
+  ecs.par_view<Position>(jobs, [&](Entity e, Position &p) {
+    CommandBuffer &cmd = cmds.local();
+    if ((int)p.x % 2 == 0)
+      cmd.add<Velocity>(e, 1.f, 0.f);
+    else
+      cmd.destroy(e);
+    Entity spawned = cmd.create();
+    cmd.add<Health>(spawned, 7);
+  });
+  cmds.apply(ecs);
+
+  int moving = 0, spawned = 0, alive_pos = 0;
+  ecs.view<Position, Velocity>([&](Entity, Position &, Velocity &) {
+    moving++;
+  });
+  ecs.view<Position>([&](Entity, Position &) { alive_pos++; });
+  ecs.view<Health>([&](Entity, Health &h) {
+    assert(h.hp == 7);
+    spawned++;
+  });
+  assert(moving == 10000 && alive_pos == 10000);
+  assert(spawned == 20000);
+}
+
+TEST(test_command_buffers_keep_working_set) {
+  ECS ecs;
+  JobSystem jobs(3);
+  for (int i = 0; i < 20000; i++) {
+    Entity e = ecs.create_entity();
+    ecs.add<Position>(e, (float)i, 0.f);
+  }
+
+  // the same load every frame: merged chunks must go back to their
+  // threads instead of piling up in the first buffer
+  CommandBuffers cmds(jobs);
+  size_t first_frame = 0;
+  for (int frame = 0; frame < 30; frame++) {
+    ecs.par_view<Position>(jobs, [&](Entity e, Position &) {
+      cmds.local().add<Velocity>(e, 1.f, 0.f);
+    });
+    cmds.apply(ecs);
+    if (frame == 0)
+      first_frame = cmds.capacity();
+  }
+  // each buffer holds at most one frame's records
+  assert(cmds.capacity() <= 2 * (jobs.thread_count() + 1) * first_frame);
+
+  int moving = 0;
+  ecs.view<Velocity>([&](Entity, Velocity &) { moving++; });
+  assert(moving == 20000);
+}
@@ -1,9 +1,13 @@
 #pragma once
+#include "../engine/command_buffer.h"
 #include "../engine/ecs.h"
 #include "ecs_sample_components.h"
 #include "test_lib.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <memory>
 #include <random>
 #include <vector>
 
@@ -92,3 +96,975 @@ TEST(test_ecs_random_access) {
 
   assert(alive_count > 0);
 }
+
+TEST(test_ecs_component_ids_per_world) {
+  // Worlds register types in different orders; family ids are shared but
+  // mask bits stay compact per world.
+  ECS a, b;
+  Entity ea = a.create_entity();
+  Entity eb = b.create_entity();
+
+  a.add<Position>(ea, 1.f, 1.f);
+  a.add<Health>(ea, 7);
+  b.add<Health>(eb, 9);
+
+  assert(a.component_id<Position>() == 0);
+  assert(a.component_id<Health>() == 1);
+  assert(b.component_id<Health>() == 0);
+  assert(!b.has<Position>(eb));
+  assert(a.get<Health>(ea).hp == 7 && b.get<Health>(eb).hp == 9);
+}
+
+TEST(test_ecs_view_driver_components) {
+  // Health is the smallest storage, so it drives the loop; every component
+  // handed to the callback must still belong to the same entity.
+  ECS ecs;
+  std::vector<Entity> ents;
+  for (int i = 0; i < 1000; i++) {
+    Entity e = ecs.create_entity();
+    ecs.add<Position>(e, float(i), 0.f);
+    if (i % 2 == 0)
+      ecs.add<Velocity>(e, float(i), 0.f);
+    if (i % 7 == 0)
+      ecs.add<Health>(e, i);
+    ents.push_back(e);
+  }
+
+  int matched = 0;
+  ecs.view<Position, Velocity, Health>(
+      [&](Entity e, Position &p, Velocity &v, Health &h) {
+        assert(p.x == float(e.index) && v.vx == float(e.index));
+        assert(h.hp == int(e.index));
+        h.hp = -1;
+        matched++;
+      });
+  assert(matched == 72);
+  assert(ecs.get<Health>(ents[14]).hp == -1);
+}
+
+TEST(test_ecs_query_invalidation) {
+  ECS ecs;
+  // Built before any storage exists: must pick them up once they appear.
+  auto q = ecs.query<Position, Velocity>();
+  int count = 0;
+  q.each([&](Entity, Position &, Velocity &) { count++; });
+  assert(count == 0);
+
+  std::vector<Entity> ents;
+  for (int i = 0; i < 100; i++) {
+    Entity e = ecs.create_entity();
+    ecs.add<Position>(e, float(i), 0.f);
+    ents.push_back(e);
+  }
+  ecs.add<Velocity>(ents[3], 1.f, 0.f);
+
+  count = 0;
+  q.each([&](Entity, Position &, Velocity &) { count++; });
+  assert(count == 1);
+
+  // Velocity outgrows Position's match set; results must stay exact.
+  for (int i = 0; i < 100; i += 2)
+    ecs.add<Velocity>(ents[i], 1.f, 0.f);
+  for (int i = 0; i < 100; i += 4)
+    ecs.remove<Position>(ents[i]);
+
+  count = 0;
+  q.each([&](Entity e, Position &p, Velocity &) {
+    assert(p.x == float(e.index));
+    count++;
+  });
+  assert(count == 26);
+}
+
+TEST(test_ecs_owning_group) {
+  ECS ecs;
+  std::vector<Entity> ents;
+  for (int i = 0; i < 300; i++) {
+    Entity e = ecs.create_entity();
+    ecs.add<Position>(e, float(i), 0.f);
+    if (i % 3 == 0)
+      ecs.add<Velocity>(e, float(i), 0.f);
+    ents.push_back(e);
+  }
+
+  // Existing matches are packed on creation.
+  auto group = ecs.owning_group<Position, Velocity>();
+  assert(group.size() == 100);
+
+  // Maintained on add, remove and destroy.
+  ecs.add<Velocity>(ents[1], 1.f, 0.f);
+  ecs.remove<Position>(ents[3]);
+  ecs.remove<Velocity>(ents[6]);
+  ecs.destroy_entity(ents[9]);
+  ecs.add<Position>(ents[3], 3.f, 0.f);
+  assert(group.size() == 99);
+
+  int count = 0;
+  group.each([&](Entity e, Position &p, Velocity &v) {
+    assert(ecs.is_alive(e));
+    assert(p.x == float(e.index));
+    assert(v.vx == float(e.index));
+    count++;
+  });
+  assert(count == 99);
+
+  int view_count = 0;
+  ecs.view<Position, Velocity>(
+      [&](Entity, Position &, Velocity &) { view_count++; });
+  assert(view_count == count);
+}
+
+TEST(test_ecs_non_owning_group) {
+  ECS ecs;
+  std::vector<Entity> ents;
+  for (int i = 0; i < 300; i++) {
+    Entity e = ecs.create_entity();
+    ecs.add<Position>(e, float(i), 0.f);
+    if (i % 3 == 0)
+      ecs.add<Velocity>(e, float(i), 0.f);
+    ents.push_back(e);
+  }
+
+  auto group = ecs.non_owning_group<Position, Velocity>();
+  assert(group.size() == 100);
+
+  // Coexists with an owning group over one of the same types.
+  auto owning = ecs.owning_group<Velocity, Health>();
+  ecs.add<Health>(ents[0], 5);
+
+  ecs.add<Velocity>(ents[1], 1.f, 0.f);
+  ecs.remove<Position>(ents[3]);
+  ecs.remove<Velocity>(ents[6]);
+  ecs.destroy_entity(ents[9]);
+  assert(group.size() == 98);
+  assert(owning.size() == 1);
+
+  group.sort();
+  uint32_t last = 0;
+  int count = 0;
+  group.each([&](Entity e, Position &p, Velocity &v) {
+    assert(e.index >= last);
+    assert(p.x == float(e.index) && v.vx == float(e.index));
+    last = e.index;
+    count++;
+  });
+  assert(count == 98);
+
+  ECS::Group mask = ecs.create_group<Position, Velocity>();
+  for (uint32_t ent : group.entities())
+    assert(ecs.matches_group(Entity{ent, ents[ent].version}, mask));
+}
+
+TEST(test_ecs_par_view) {
+  ECS ecs;
+  JobSystem jobs(4);
+  for (int i = 0; i < 50000; i++) {
+    Entity e = ecs.create_entity();
+    ecs.add<Position>(e, float(i), 0.f);
+    if (i % 2 == 0)
+      ecs.add<Velocity>(e, 1.f, 0.f);
+  }
+
+  std::atomic<int> count{0};
+  ecs.par_view<Position, Velocity>(
+      jobs, [&](Entity, Position &p, Velocity &v) {
+        p.x += v.vx;
+        count++;
+      });
+  assert(count == 25000);
+
+  ecs.view<Position>([&](Entity e, Position &p) {
+    assert(p.x == float(e.index) + (e.index % 2 == 0 ? 1.f : 0.f));
+  });
+}
+
+TEST(test_ecs_bulk_create_and_add) {
+  ECS ecs;
+  auto grp = ecs.non_owning_group<Position, Velocity>();
+
+  // leave some holes in the free list
+  std::vector<Entity> old(10);
+  ecs.create_entities(old.size(), old.data());
+  for (int i = 0; i < 10; i += 2)
+    ecs.destroy_entity(old[i]);
+
+  std::vector<Entity> ents(5000);
+  ecs.create_entities(ents.size(), ents.data());
+  for (Entity e : ents)
+    assert(ecs.is_alive(e));
+  // recycled slots come first and carry their bumped version
+  assert(ents[0].index < 10 && ents[0].version == 2);
+  for (size_t i = 5; i < ents.size(); i++)
+    assert(ents[i].index == 10 + i - 5 && ents[i].version == 1);
+
+  std::vector<Position> pos(ents.size());
+  for (size_t i = 0; i < pos.size(); i++)
+    pos[i] = {(float)i, -(float)i};
+  ecs.add_bulk<Position>(ents, pos);
+
+  // second bulk call over a subset overwrites existing values
+  Span<const Entity> half(ents.data(), ents.size() / 2);
+  std::vector<Position> moved(half.size(), Position{7.f, 7.f});
+  ecs.add_bulk<Position>(half, moved);
+
+  for (size_t i = 0; i < ents.size(); i++) {
+    assert(ecs.has<Position>(ents[i]));
+    float expect = i < half.size() ? 7.f : (float)i;
+    assert(ecs.get<Position>(ents[i]).x == expect);
+  }
+
+  // groups still pick up bulk-added components
+  std::vector<Velocity> vel(100, Velocity{1.f, 1.f});
+  ecs.add_bulk<Velocity>(Span<const Entity>(ents.data(), 100), vel);
+  assert(grp.size() == 100);
+
+  int count = 0;
+  ecs.view<Position, Velocity>(
+      [&](Entity, Position &, Velocity &) { count++; });
+  assert(count == 100);
+
+  // an entity listed twice is added once and keeps its last value
+  int constructed = 0, updated = 0;
+  auto on_construct = [&](ECS &, Entity) { constructed++; };
+  auto on_update = [&](ECS &, Entity) { updated++; };
+  ecs.on_construct<Health>().connect(on_construct);
+  ecs.on_update<Health>().connect(on_update);
+  std::vector<Entity> twice = {ents[0], ents[1], ents[0]};
+  std::vector<Health> hp = {{1}, {2}, {3}};
+  ecs.add_bulk<Health>(twice, hp);
+  assert(ecs.storage<Health>().size() == 2);
+  assert(ecs.get<Health>(ents[0]).hp == 3);
+  assert(constructed == 2 && updated == 1);
+}
+
+// Distinct component types for worlds with many storages
+template <int N> struct Numbered {
+  int value;
+};
+
+template <typename World, int... Ns>
+static void add_numbered(World &ecs, Entity e,
+                         std::integer_sequence<int, Ns...>) {
+  (ecs.template add<Numbered<Ns>>(e, Ns), ...);
+}
+
+TEST(test_ecs_destroy_touches_owned_storages) {
+  ECS ecs;
+  auto owning = ecs.owning_group<Position, Velocity>();
+  auto watching = ecs.non_owning_group<Position, Health>();
+
+  // 70 extra types: masks span two blocks
+  Entity wide = ecs.create_entity();
+  add_numbered(ecs, wide, std::make_integer_sequence<int, 70>{});
+  ecs.add<Position>(wide, 0.f, 0.f);
+
+  std::vector<Entity> ents(300);
+  ecs.create_entities(ents.size(), ents.data());
+  for (size_t i = 0; i < ents.size(); i++) {
+    ecs.add<Position>(ents[i], (float)i, 0.f);
+    if (i % 2 == 0)
+      ecs.add<Velocity>(ents[i], 1.f, 1.f);
+    if (i % 3 == 0)
+      ecs.add<Health>(ents[i], (int)i);
+    if (i % 5 == 0)
+      ecs.add<Numbered<69>>(ents[i], 69);
+  }
+  assert(owning.size() == 150 && watching.size() == 100);
+
+  ecs.destroy_entity(wide);
+  ecs.destroy_entity(ents[0]);
+  assert(!ecs.is_alive(wide) && !ecs.is_alive(ents[0]));
+  assert(owning.size() == 149 && watching.size() == 99);
+
+  // bulk: every 4th entity, with a duplicate and an already-dead handle
+  std::vector<Entity> doomed;
+  for (size_t i = 0; i < ents.size(); i += 4)
+    doomed.push_back(ents[i]);
+  doomed.push_back(ents[4]);
+  ecs.destroy_entities(doomed);
+
+  size_t expect_pos = 0, expect_pair = 0, expect_hp = 0, expect_69 = 0;
+  for (size_t i = 0; i < ents.size(); i++) {
+    bool dead = i % 4 == 0;
+    assert(ecs.is_alive(ents[i]) == !dead);
+    if (dead)
+      continue;
+    expect_pos++;
+    expect_pair += i % 2 == 0;
+    expect_hp += i % 3 == 0;
+    expect_69 += i % 5 == 0;
+  }
+  assert(owning.size() == expect_pair && watching.size() == expect_hp);
+
+  size_t pos = 0, num = 0, pair = 0;
+  ecs.view<Position>([&](Entity, Position &) { pos++; });
+  ecs.view<Numbered<69>>([&](Entity, Numbered<69> &) { num++; });
+  owning.each([&](Entity e, Position &, Velocity &) {
+    assert(ecs.is_alive(e));
+    pair++;
+  });
+  assert(pos == expect_pos && num == expect_69 && pair == expect_pair);
+
+  // slots are recycled with bumped versions and come back empty
+  Entity reused = ecs.create_entity();
+  assert(reused.version == 2);
+  assert(!ecs.has<Position>(reused) && !ecs.has<Numbered<0>>(reused));
+}
+
+TEST(test_ecs_has_get_and_storage_handle) {
+  ECS ecs;
+  std::vector<Entity> ents(200);
+  ecs.create_entities(ents.size(), ents.data());
+  for (size_t i = 0; i < ents.size(); i++) {
+    ecs.add<Position>(ents[i], (float)i, 0.f);
+    if (i % 3 == 0)
+      ecs.add<Velocity>(ents[i], (float)i, 1.f);
+  }
+  ecs.remove<Velocity>(ents[3]);
+  ecs.destroy_entity(ents[6]);
+
+  for (size_t i = 0; i < ents.size(); i++) {
+    bool alive = i != 6;
+    assert(ecs.has<Position>(ents[i]) == alive);
+    assert(ecs.has<Velocity>(ents[i]) == (alive && i % 3 == 0 && i != 3));
+    // an unseen type answers false without being registered
+    assert(!ecs.has<Health>(ents[i]));
+  }
+  assert(ecs.component_id<Health>() == 2);
+
+  // stale handles never report components of the slot's new owner
+  Entity reused = ecs.create_entity();
+  ecs.add<Position>(reused, 1.f, 1.f);
+  assert(reused.index == ents[6].index && !ecs.has<Position>(ents[6]));
+
+  auto vel = ecs.storage<Velocity>();
+  assert(vel.size() == 65);
+  float sum = 0;
+  for (Entity e : ents)
+    if (ecs.has<Velocity>(e))
+      sum += vel.get_unchecked(e.index).vx;
+  float expect = 0;
+  for (size_t i = 0; i < ents.size(); i += 3)
+    if (i != 3 && i != 6)
+      expect += (float)i;
+  assert(sum == expect);
+
+  vel.get_unchecked(ents[0].index).vy = 9.f;
+  assert(ecs.get<Velocity>(ents[0]).vy == 9.f);
+  assert(vel.contains(ents[9].index) && !vel.contains(ents[1].index));
+}
+
+TEST(test_ecs_fixed_mask_world) {
+  BasicECS<128> ecs;
+  auto owning = ecs.owning_group<Position, Velocity>();
+  auto watching = ecs.non_owning_group<Position, Health>();
+  auto grp = ecs.create_group<Velocity, Numbered<69>>();
+
+  std::vector<Entity> ents(100);
+  ecs.create_entities(ents.size(), ents.data());
+  for (size_t i = 0; i < ents.size(); i++) {
+    ecs.add<Position>(ents[i], (float)i, 0.f);
+    if (i % 2 == 0)
+      ecs.add<Velocity>(ents[i], 1.f, 0.f);
+    if (i % 4 == 0)
+      ecs.add<Health>(ents[i], 1);
+  }
+  // 70 more types, crossing the first 64-bit block
+  add_numbered(ecs, ents[10], std::make_integer_sequence<int, 70>{});
+  assert(ecs.has<Numbered<69>>(ents[10]) && !ecs.has<Numbered<69>>(ents[9]));
+  assert(ecs.matches_group(ents[10], grp) && !ecs.matches_group(ents[8], grp));
+
+  assert(owning.size() == 50 && watching.size() == 25);
+  ecs.remove<Velocity>(ents[0]);
+  ecs.destroy_entity(ents[4]);
+  ecs.destroy_entity(ents[10]);
+  assert(owning.size() == 47 && watching.size() == 24);
+
+  int count = 0;
+  ecs.view<Position, Velocity>([&](Entity, Position &, Velocity &) {
+    count++;
+  });
+  assert(count == 47);
+  auto q = ecs.query<Numbered<0>>();
+  int numbered = 0;
+  q.each([&](Entity, Numbered<0> &) { numbered++; });
+  assert(numbered == 0);
+}
+
+TEST(test_ecs_view_filter_blocks) {
+  ECS ecs;
+  // enough entities for several filter blocks plus a ragged tail
+  std::vector<Entity> ents(1000 + 3);
+  ecs.create_entities(ents.size(), ents.data());
+  for (size_t i = 0; i < ents.size(); i++) {
+    ecs.add<Position>(ents[i], (float)i, 0.f);
+    if (i % 7 == 0)
+      ecs.add<Velocity>(ents[i], 1.f, 0.f);
+    if (i % 3 == 0)
+      ecs.add<Health>(ents[i], (int)i);
+  }
+  // more Velocity than Health holders outside the match set: drives by Health
+  for (size_t i = 0; i < 200; i++)
+    ecs.add<Velocity>(ecs.create_entity(), 0.f, 0.f);
+
+  std::vector<uint32_t> seen;
+  ecs.view<Position, Velocity, Health>(
+      [&](Entity e, Position &p, Velocity &, Health &h) {
+        assert(p.x == (float)e.index && h.hp == (int)e.index);
+        seen.push_back(e.index);
+      });
+  std::vector<uint32_t> expect;
+  for (size_t i = 0; i < ents.size(); i += 21)
+    expect.push_back(ents[i].index);
+  assert(seen == expect);
+
+  // structural changes made by fn are seen by the rest of the block
+  seen.clear();
+  ecs.view<Velocity, Health>([&](Entity e, Velocity &, Health &) {
+    seen.push_back(e.index);
+    if (e.index == ents[21].index) {
+      ecs.remove<Velocity>(ents[42]);
+      ecs.add<Velocity>(ents[45], 2.f, 0.f);
+    }
+  });
+  assert(std::find(seen.begin(), seen.end(), ents[42].index) == seen.end());
+  assert(std::find(seen.begin(), seen.end(), ents[45].index) != seen.end());
+  assert(seen.size() == expect.size());
+
+  std::atomic<size_t> par_count{0};
+  ecs.par_view<Position, Velocity, Health>(
+      [&](Entity, Position &, Velocity &, Health &) { par_count++; });
+  assert(par_count.load() == expect.size());
+}
+
+struct Dead {};
+
+TEST(test_ecs_view_exclude_and_optional) {
+  ECS ecs;
+  std::vector<Entity> ents(300);
+  ecs.create_entities(ents.size(), ents.data());
+  for (size_t i = 0; i < ents.size(); i++) {
+    ecs.add<Position>(ents[i], (float)i, 0.f);
+    if (i % 2 == 0)
+      ecs.add<Velocity>(ents[i], (float)i, 0.f);
+    if (i % 5 == 0)
+      ecs.add<Health>(ents[i], (int)i);
+  }
+
+  // excluding a type nothing has yet excludes nothing
+  int count = 0;
+  ecs.view<Position>(exclude<Dead>, [&](Entity, Position &) { count++; });
+  assert(count == 300);
+
+  for (size_t i = 0; i < ents.size(); i += 3)
+    ecs.add<Dead>(ents[i]);
+  count = 0;
+  ecs.view<Position, Velocity>(exclude<Dead>,
+                               [&](Entity e, Position &, Velocity &) {
+                                 assert(!ecs.has<Dead>(e));
+                                 count++;
+                               });
+  assert(count == 100); // even, not a multiple of 3
+
+  // several excluded types, one of them without storage
+  count = 0;
+  ecs.view<Position>(exclude<Dead, Health, Acceleration>,
+                     [&](Entity e, Position &) {
+                       assert(!ecs.has<Dead>(e) && !ecs.has<Health>(e));
+                       count++;
+                     });
+  assert(count == 160); // 200 not dead, minus 40 with Health
+
+  // optional parameters are nullptr when absent and never filter
+  int with_vel = 0, with_hp = 0;
+  ecs.view<Position, Velocity *, Health *>(
+      [&](Entity e, Position &p, Velocity *v, Health *h) {
+        assert((v != nullptr) == ecs.has<Velocity>(e));
+        assert((h != nullptr) == ecs.has<Health>(e));
+        if (v) {
+          assert(v->vx == p.x);
+          with_vel++;
+        }
+        with_hp += h != nullptr;
+      });
+  assert(with_vel == 150 && with_hp == 60);
+
+  // a small optional storage must not drive the view
+  auto q = ecs.query<Velocity, Health *>(exclude<Dead>);
+  count = 0;
+  q.each([&](Entity, Velocity &, Health *) { count++; });
+  assert(count == 100);
+  ecs.remove<Dead>(ents[0]);
+  count = 0;
+  q.each([&](Entity, Velocity &, Health *h) { count += h != nullptr; });
+  assert(count == 21); // multiples of 10 not dead, plus entity 0
+
+  std::atomic<int> par_count{0};
+  ecs.par_view<Position, Acceleration *>(
+      exclude<Dead>, [&](Entity, Position &, Acceleration *a) {
+        assert(a == nullptr);
+        par_count++;
+      });
+  assert(par_count.load() == 201);
+}
+
+struct Selected {};
+
+TEST(test_ecs_tag_components) {
+  static_assert(std::is_same_v<ComponentSet<Selected>, TagSet<Selected>>);
+  ECS ecs;
+  auto grp = ecs.owning_group<Position, Selected>();
+  std::vector<Entity> ents(100);
+  ecs.create_entities(ents.size(), ents.data());
+  for (size_t i = 0; i < ents.size(); i++) {
+    ecs.add<Position>(ents[i], (float)i, 0.f);
+    if (i % 4 == 0)
+      ecs.add<Selected>(ents[i]);
+  }
+  ecs.add<Selected>(ents[0]); // adding twice is a no-op
+  assert(ecs.has<Selected>(ents[4]) && !ecs.has<Selected>(ents[5]));
+  assert(ecs.storage<Selected>().size() == 25 && grp.size() == 25);
+
+  // tags filter but are not passed to the callback
+  float sum = 0;
+  ecs.view<Position, Selected>([&](Entity e, Position &p) {
+    assert(ecs.has<Selected>(e));
+    sum += p.x;
+  });
+  assert(sum == 1200.f); // 0 + 4 + ... + 96
+  int count = 0;
+  ecs.view<Selected>([&](Entity) { count++; });
+  assert(count == 25);
+  count = 0;
+  grp.each([&](Entity, Position &) { count++; });
+  assert(count == 25);
+
+  // optional tags arrive as pointers
+  count = 0;
+  ecs.view<Position, Selected *>([&](Entity e, Position &, Selected *s) {
+    assert((s != nullptr) == ecs.has<Selected>(e));
+    count += s != nullptr;
+  });
+  assert(count == 25);
+
+  ecs.remove<Selected>(ents[4]);
+  ecs.destroy_entity(ents[8]);
+  assert(!ecs.has<Selected>(ents[4]) && grp.size() == 23);
+  assert(ecs.storage<Selected>().size() == 23);
+  count = 0;
+  ecs.view<Position>(exclude<Selected>,
+                     [&](Entity, Position &) { count++; });
+  assert(count == 99 - 23);
+}
+
+TEST(test_ecs_change_filters) {
+  ECS ecs;
+  std::vector<Entity> ents(200);
+  ecs.create_entities(ents.size(), ents.data());
+  for (size_t i = 0; i < ents.size(); i++)
+    ecs.add<Position>(ents[i], (float)i, 0.f);
+  for (size_t i = 0; i < 100; i++)
+    ecs.add<Velocity>(ents[i], 1.f, 0.f);
+
+  auto added = ecs.query<Added<Position>>();
+  auto changed = ecs.query<const Position, Changed<Position>>();
+  auto removed = ecs.query<Removed<Velocity>>();
+  auto count = [](auto &q) {
+    int n = 0;
+    q.each([&](Entity, auto &&...) { n++; });
+    return n;
+  };
+  // the first run sees everything that already exists; nothing was removed
+  assert(count(added) == 200 && count(changed) == 200);
+  assert(count(removed) == 0);
+  assert(count(added) == 0 && count(changed) == 0);
+
+  // writes through views, get<T> and groups count as changes; const
+  // parameters, get<const T> and the query's own reads don't
+  ecs.view<Position, Velocity>([](Entity, Position &p, Velocity &v) {
+    p.x += v.vx;
+  });
+  ecs.get<Position>(ents[150]);
+  ecs.view<const Position>([](Entity, const Position &) {});
+  const Position &read = ecs.get<const Position>(ents[180]);
+  assert(read.x == 180.f);
+  assert(count(changed) == 101 && count(added) == 0);
+
+  // new and overwritten components; removed ones leave the tick arrays
+  Entity fresh = ecs.create_entity();
+  ecs.add<Position>(fresh, 1.f, 1.f);
+  ecs.add<Position>(ents[7], 2.f, 2.f);
+  ecs.remove<Position>(ents[199]);
+  ecs.destroy_entity(ents[198]);
+  std::vector<Entity> seen;
+  added.each([&](Entity e) { seen.push_back(e); });
+  assert(seen.size() == 1 && seen[0] == fresh);
+  seen.clear();
+  changed.each([&](Entity e, const Position &) { seen.push_back(e); });
+  assert(seen.size() == 2);
+
+  // removals: once per entity, only while it still lacks the component
+  ecs.remove<Velocity>(ents[3]);
+  ecs.remove<Velocity>(ents[4]);
+  ecs.add<Velocity>(ents[4], 0.f, 0.f);
+  ecs.remove<Velocity>(ents[5]);
+  ecs.destroy_entity(ents[5]);
+  seen.clear();
+  removed.each([&](Entity e) { seen.push_back(e); });
+  assert(seen.size() == 1 && seen[0] == ents[3]);
+  assert(count(removed) == 0);
+
+  // an index removed under several versions is visited once per live one
+  std::vector<Entity> again(300);
+  ecs.create_entities(again.size(), again.data());
+  for (Entity &e : again) {
+    ecs.add<Velocity>(e, 0.f, 0.f);
+    ecs.remove<Velocity>(e);
+    ecs.destroy_entity(e);
+    e = ecs.create_entity();
+    for (int k = 0; k < 2; k++) {
+      ecs.add<Velocity>(e, 0.f, 0.f);
+      ecs.remove<Velocity>(e);
+    }
+  }
+  assert(count(removed) == (int)again.size());
+
+  // one-shot views look back to the last advance_frame()
+  ecs.advance_frame();
+  int n = 0;
+  ecs.view<Changed<Position>>([&](Entity) { n++; });
+  assert(n == 0);
+  ecs.get<Position>(ents[0]).x = 5.f;
+  ecs.view<Position, Changed<Position>>([&](Entity e, Position &p) {
+    assert(e == ents[0] && p.x == 5.f);
+    n++;
+  });
+  assert(n == 1);
+
+  // group packing reorders storages; ticks must follow their entries
+  auto grp = ecs.owning_group<Position, Velocity>();
+  assert(count(changed) == 1); // ents[0], from the views above
+  ecs.get<Position>(ents[150]);
+  seen.clear();
+  changed.each([&](Entity e, const Position &) { seen.push_back(e); });
+  assert(seen.size() == 1 && seen[0] == ents[150]);
+  grp.each([](Entity, Position &, Velocity &) {});
+  assert(count(changed) == (int)grp.size());
+}
+
+// Keeps a derived index (entities by cell) in sync through the signals.
+struct CellIndex {
+  std::vector<Entity> constructed, updated, destroyed;
+  void on_construct(ECS &ecs, Entity e) {
+    assert(ecs.has<Position>(e));
+    constructed.push_back(e);
+  }
+  void on_update(ECS &, Entity e) { updated.push_back(e); }
+  void on_destroy(ECS &ecs, Entity e) {
+    // still alive and still holding the component
+    assert(ecs.is_alive(e) && ecs.has<Position>(e));
+    destroyed.push_back(e);
+  }
+};
+
+TEST(test_ecs_component_signals) {
+  ECS ecs;
+  CellIndex index;
+  ecs.on_construct<Position>().connect<&CellIndex::on_construct>(index);
+  ecs.on_update<Position>().connect<&CellIndex::on_update>(index);
+  ecs.on_destroy<Position>().connect<&CellIndex::on_destroy>(index);
+  auto grp = ecs.owning_group<Position, Velocity>();
+
+  std::vector<Entity> ents(6);
+  ecs.create_entities(ents.size(), ents.data());
+  for (size_t i = 0; i < 4; i++) {
+    ecs.add<Velocity>(ents[i], 1.f, 1.f);
+    ecs.add<Position>(ents[i], (float)i, 0.f);
+  }
+  assert(index.constructed.size() == 4 && grp.size() == 4);
+
+  // overwrite and patch are updates
+  ecs.add<Position>(ents[0], 9.f, 9.f);
+  Position &p = ecs.patch<Position>(
+      ents[1], [](Position &p) { p.x = 5.f; }, [](Position &p) { p.y += 1.f; });
+  assert(p.x == 5.f && p.y == 1.f);
+  assert(index.updated.size() == 2 && index.updated[1] == ents[1]);
+
+  // bulk add: construct for new entities, update for existing ones
+  std::vector<Entity> batch = {ents[4], ents[0], ents[5]};
+  std::vector<Position> values(3, Position{0.f, 0.f});
+  ecs.add_bulk<Position>(batch, values);
+  assert(index.constructed.size() == 6 && index.updated.size() == 3);
+
+  // remove, destroy and destroy_entities all publish on_destroy once
+  ecs.remove<Position>(ents[2]);
+  ecs.remove<Position>(ents[2]);
+  ecs.destroy_entity(ents[3]);
+  std::vector<Entity> doomed = {ents[4], ents[4], ents[5]};
+  ecs.destroy_entities(doomed);
+  assert(index.destroyed.size() == 4);
+  assert(index.destroyed[0] == ents[2] && index.destroyed[1] == ents[3]);
+
+  // listeners can drive other structural changes
+  auto tag_moving = [](ECS &ecs, Entity e) { ecs.add<Velocity>(e, 0.f, 0.f); };
+  ecs.on_construct<Position>().connect(tag_moving);
+  Entity fresh = ecs.create_entity();
+  Position &q = ecs.add<Position>(fresh, 3.f, 3.f);
+  assert(q.x == 3.f && ecs.has<Velocity>(fresh) && grp.size() == 3);
+
+  ecs.on_construct<Position>().disconnect(tag_moving);
+  ecs.on_construct<Position>().clear();
+  ecs.add<Position>(ecs.create_entity(), 0.f, 0.f);
+  assert(index.constructed.size() == 7);
+}
+
+struct Spawned {};
+
+TEST(test_ecs_destroy_listener_grows_world) {
+  // on_destroy listeners that create entities or register types reallocate
+  // the masks while destroy_entity/destroy_entities walk them; the first
+  // entity they create also gets a type the destroy is still erasing
+  ECS ecs;
+  std::vector<Entity> healed;
+  auto spawn = [&](ECS &ecs, Entity) {
+    healed.push_back(ecs.create_entity());
+    ecs.add<Health>(healed.back(), 7);
+    for (int i = 1; i < 5000; i++)
+      ecs.add<Spawned>(ecs.create_entity());
+  };
+  ecs.on_destroy<Position>().connect(spawn);
+
+  Entity e = ecs.create_entity();
+  ecs.add<Position>(e, 1.f, 1.f);
+  ecs.add<Velocity>(e, 1.f, 1.f);
+  ecs.add<Health>(e, 3);
+  ecs.destroy_entity(e);
+  assert(!ecs.is_alive(e) && ecs.storage<Spawned>().size() == 4999);
+  assert(ecs.storage<Position>().size() == 0);
+  assert(ecs.storage<Velocity>().size() == 0);
+  assert(ecs.storage<Health>().size() == 1);
+
+  std::vector<Entity> ents(3);
+  ecs.create_entities(ents.size(), ents.data());
+  for (Entity x : ents) {
+    ecs.add<Position>(x, 0.f, 0.f);
+    ecs.add<Health>(x, 1);
+  }
+  ecs.destroy_entities(ents);
+  assert(ecs.storage<Spawned>().size() == 4 * 4999);
+  assert(ecs.storage<Position>().size() == 0);
+  assert(ecs.storage<Health>().size() == 4);
+  // indices of the batch are not recycled until its storages are erased
+  for (Entity h : healed) {
+    assert(ecs.has<Health>(h) && ecs.storage<Health>().contains(h.index));
+    assert(ecs.get<const Health>(h).hp == 7);
+  }
+  Entity fresh = ecs.create_entity();
+  assert(!ecs.has<Position>(fresh) && !ecs.has<Health>(fresh));
+}
+
+TEST(test_ecs_emplace_replace_move_only) {
+  ECS ecs;
+  Entity a = ecs.create_entity();
+  Entity b = ecs.create_entity();
+  ecs.emplace<std::unique_ptr<int>>(a, new int(1));
+  ecs.add<std::unique_ptr<int>>(b, std::make_unique<int>(2));
+  ecs.replace<std::unique_ptr<int>>(a, new int(3));
+  assert(*ecs.get<std::unique_ptr<int>>(a) == 3);
+  ecs.remove<std::unique_ptr<int>>(a);
+  assert(*ecs.get<std::unique_ptr<int>>(b) == 2);
+
+  // heap-owning components are moved around, never copied
+  struct Path {
+    std::vector<int> points;
+  };
+  std::vector<Entity> ents(50);
+  ecs.create_entities(ents.size(), ents.data());
+  for (Entity e : ents)
+    ecs.add<Path>(e, std::vector<int>(16, 1));
+  const int *first = ecs.get<Path>(ents.back()).points.data();
+  ecs.remove<Path>(ents[0]); // moves the last Path into slot 0
+  assert(ecs.get<Path>(ents.back()).points.data() == first);
+
+  CommandBuffer cmd;
+  cmd.add<Path>(ents[0], std::vector<int>(8, 2));
+  cmd.apply(ecs);
+  assert(ecs.get<Path>(ents[0]).points.size() == 8);
+}
+
+// Component kept at a fixed address for as long as its entity has it.
+struct Anchor {
+  float x;
+  std::vector<int> links = {};
+};
+template <> struct ComponentTraits<Anchor> {
+  static constexpr size_t page_size = 256;
+  static constexpr bool in_place_delete = true;
+};
+// Paged but swap-removed: stable while growing, usable by owning groups.
+struct Trail {
+  float len;
+};
+template <> struct ComponentTraits<Trail> {
+  static constexpr size_t page_size = 128;
+  static constexpr bool in_place_delete = false;
+};
+
+TEST(test_ecs_paged_and_stable_storage) {
+  ECS ecs;
+  std::vector<Entity> ents(3000);
+  ecs.create_entities(ents.size(), ents.data());
+  std::vector<Anchor *> addr;
+  for (size_t i = 0; i < ents.size(); i++) {
+    addr.push_back(&ecs.add<Anchor>(ents[i], (float)i));
+    ecs.add<Position>(ents[i], (float)i, 0.f);
+    if (i % 3 == 0)
+      ecs.add<Trail>(ents[i], 1.f);
+  }
+  auto changed = ecs.query<const Anchor, Changed<Anchor>>();
+  changed.each([](Entity, const Anchor &) {});
+
+  for (size_t i = 0; i < ents.size(); i += 2)
+    ecs.remove<Anchor>(ents[i]);
+  ecs.destroy_entity(ents[1]);
+  for (size_t i = 3; i < ents.size(); i += 2)
+    assert(&ecs.get<Anchor>(ents[i]) == addr[i]);
+  assert(ecs.storage<Anchor>().size() == 1499);
+
+  // views, parallel views and change filters skip the holes
+  size_t count = 0;
+  float sum = 0;
+  ecs.view<Anchor, Position>([&](Entity e, Anchor &a, Position &p) {
+    assert(a.x == p.x && e.index % 2 == 1);
+    count++;
+  });
+  assert(count == 1499);
+  std::atomic<int> par{0};
+  ecs.par_view<Anchor>([&](Entity, Anchor &) { par++; });
+  assert(par == 1499);
+  count = 0;
+  changed.each([&](Entity e, const Anchor &) {
+    assert(e.index % 2 == 1);
+    count++;
+  });
+  assert(count == 1499); // the views above wrote them all
+
+  // holes are refilled, ticks and all
+  for (size_t i = 0; i < 10; i += 2)
+    ecs.add<Anchor>(ents[i], -1.f);
+  auto added = ecs.query<Added<Anchor>>();
+  added.each([](Entity) {});
+  ecs.add<Anchor>(ents[20], -2.f);
+  count = 0;
+  added.each([&](Entity e) {
+    assert(e == ents[20]);
+    count++;
+  });
+  assert(count == 1);
+  auto grp = ecs.non_owning_group<Anchor, Position>();
+  assert(grp.size() == 1499 + 6);
+
+  // paged storages without holes work with owning groups
+  auto owned = ecs.owning_group<Trail, Position>();
+  owned.each([&](Entity e, Trail &t, Position &) {
+    assert(e.index % 3 == 0);
+    sum += t.len;
+  });
+  assert(sum == (float)owned.size() && owned.size() == 1000);
+  ecs.remove<Trail>(ents[0]);
+  assert(owned.size() == 999);
+}
+
+TEST(test_ecs_memory_reclaim) {
+  ECS ecs;
+  std::vector<Entity> ents(100000);
+  ecs.create_entities(ents.size(), ents.data());
+  for (Entity e : ents) {
+    ecs.add<Position>(e, 1.f, 2.f);
+    ecs.add<Velocity>(e, 3.f, 4.f);
+  }
+  auto grp = ecs.non_owning_group<Position, Velocity>();
+  assert(grp.size() == ents.size());
+  const auto full = ecs.memory_stats();
+  assert(full.sparse_bytes > 0 && full.pooled_bytes == 0);
+
+  // emptied sparse pages land in the world's pool as entities go away
+  ecs.destroy_entities(Span<const Entity>(ents).subspan(50000, 50000));
+  const auto half = ecs.memory_stats();
+  assert(half.sparse_bytes < full.sparse_bytes);
+  assert(half.pooled_bytes > 0 && half.reclaimed_bytes > 0);
+
+  // a storage that grows later takes its pages from the pool
+  for (size_t i = 0; i < 50000; i++)
+    ecs.add<Health>(ents[i], 10);
+  assert(ecs.memory_stats().pooled_bytes < half.pooled_bytes);
+
+  ecs.destroy_entities(Span<const Entity>(ents.data(), 50000));
+  const auto empty = ecs.memory_stats();
+  assert(empty.sparse_bytes == 0 && grp.size() == 0);
+
+  // shrink_to_fit hands the pool and the dense slack back
+  const size_t freed = ecs.shrink_to_fit();
+  const auto trimmed = ecs.memory_stats();
+  assert(freed >= empty.pooled_bytes && trimmed.pooled_bytes == 0);
+  assert(trimmed.dense_bytes < empty.dense_bytes);
+  assert(trimmed.reclaimed_bytes > empty.reclaimed_bytes);
+
+  // and the world keeps working
+  Entity e = ecs.create_entity();
+  ecs.add<Position>(e, 5.f, 6.f);
+  ecs.add<Velocity>(e, 7.f, 8.f);
+  assert(grp.size() == 1 && ecs.get<Position>(e).x == 5.f);
+  assert(ecs.memory_stats().sparse_bytes > 0);
+}
+
+TEST(test_ecs_for_each_of) {
+  ECS ecs;
+  std::vector<Entity> ents(1000);
+  ecs.create_entities(ents.size(), ents.data());
+  for (size_t i = 0; i < ents.size(); i++) {
+    ecs.add<Position>(ents[i], float(i), 0.f);
+    if (i % 2 == 0)
+      ecs.add<Velocity>(ents[i], 1.f, 0.f);
+  }
+  ecs.destroy_entity(ents[10]);
+  Entity reused = ecs.create_entity(); // takes index 10, no Position
+  assert(reused.index == ents[10].index);
+
+  std::vector<Entity> order(ents);
+  std::mt19937 rng(5);
+  std::shuffle(order.begin(), order.end(), rng);
+
+  // visits alive entities with all types, in the order given
+  std::vector<Entity> seen;
+  ecs.for_each_of<Position, const Velocity>(
+      order, [&](Entity e, Position &p, const Velocity &v) {
+        p.y += v.vx;
+        seen.push_back(e);
+      });
+  std::vector<Entity> expected;
+  for (Entity e : order)
+    if (ecs.is_alive(e) && ecs.has<Position>(e) && ecs.has<Velocity>(e))
+      expected.push_back(e);
+  assert(seen.size() == 499 && seen.size() == expected.size());
+  for (size_t i = 0; i < seen.size(); i++)
+    assert(seen[i] == expected[i]);
+  for (size_t i = 0; i < ents.size(); i++)
+    if (i != 10)
+      assert(ecs.get<Position>(ents[i]).y == (i % 2 == 0 ? 1.f : 0.f));
+
+  // writes count as changes; unregistered types visit nothing
+  auto changed = ecs.query<Changed<Position>>();
+  changed.each([](Entity) {});
+  ecs.for_each_of<Position>(Span<const Entity>(ents.data(), 3),
+                            [](Entity, Position &) {});
+  size_t n = 0;
+  changed.each([&](Entity) { n++; });
+  assert(n == 3);
+  ecs.for_each_of<Health>(ents, [&](Entity, Health &) { assert(false); });
+
+  // const types are handed over read-only
+  ecs.for_each_of<const Position>(ents, [](Entity, auto &p) {
+    static_assert(std::is_const_v<std::remove_reference_t<decltype(p)>>);
+  });
+}
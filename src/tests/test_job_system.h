@@ -0,0 +1,91 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <thread>
+#include <vector>
+
+#include "../engine/job_system.h"
+#include "test_lib.h"
+
+// ------------------------------------------------------------
+// TESTS
+// ------------------------------------------------------------
+TEST(test_jobs_parallel_for_covers_range) {
+  JobSystem jobs(4);
+  const size_t N = 100003;
+  std::vector<int> hits(N, 0);
+
+  for (int round = 0; round < 20; round++)
+    jobs.parallel_for(N, 97, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++)
+        hits[i]++;
+    });
+
+  for (size_t i = 0; i < N; i++)
+    assert(hits[i] == 20);
+}
+
+TEST(test_jobs_spawn_and_wait) {
+  JobSystem jobs(4);
+  JobSystem::Counter counter;
+  std::atomic<int> sum{0};
+  for (int i = 1; i <= 10000; i++)
+    jobs.spawn([&sum, i] { sum += i; }, &counter);
+  jobs.wait(counter);
+  assert(counter.done());
+  assert(sum == 10000 * 10001 / 2);
+}
+
+TEST(test_jobs_nested_parallel_for) {
+  JobSystem jobs(3);
+  std::atomic<size_t> total{0};
+  jobs.parallel_for(64, 1, [&](size_t, size_t) {
+    jobs.parallel_for(1000, 10, [&](size_t begin, size_t end) {
+      total += end - begin;
+    });
+  });
+  assert(total == 64000);
+}
+
+TEST(test_jobs_dependencies) {
+  JobSystem jobs(4);
+  JobSystem::Counter first, second;
+  std::atomic<int> stage_a{0};
+  std::atomic<bool> order_ok{true};
+
+  for (int i = 0; i < 100; i++)
+    jobs.spawn([&] { stage_a++; }, &first);
+  for (int i = 0; i < 10; i++)
+    jobs.spawn_after(
+        first,
+        [&] {
+          if (stage_a != 100)
+            order_ok = false;
+        },
+        &second);
+
+  jobs.wait(second);
+  assert(first.done());
+  assert(order_ok);
+}
+
+TEST(test_jobs_large_closures_and_foreign_threads) {
+  JobSystem jobs(2);
+  JobSystem::Counter counter;
+  std::atomic<int> sum{0};
+
+  // Captures more than fits inline; boxed on the heap.
+  std::array<int, 32> payload{};
+  payload[31] = 7;
+  jobs.spawn([&sum, payload] { sum += payload[31]; }, &counter);
+
+  // Submitted from a thread that is neither owner nor worker.
+  std::thread foreign([&] {
+    jobs.spawn([&sum] { sum += 1; }, &counter);
+  });
+  foreign.join();
+
+  jobs.wait(counter);
+  assert(sum == 8);
+}
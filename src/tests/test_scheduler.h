@@ -0,0 +1,143 @@
+#pragma once
+#include "../engine/scheduler.h"
+#include "ecs_sample_components.h"
+#include "test_lib.h"
+
+#include <atomic>
+#include <cassert>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ------------------------------------------------------------
+// TESTS
+// ------------------------------------------------------------
+TEST(test_scheduler_dependencies) {
+  Scheduler sched;
+  auto noop = [](ECS &, float) {};
+
+  auto move = sched.add("move", Reads<Velocity>{}, Writes<Position>{}, noop);
+  auto accel =
+      sched.add("accel", Reads<Acceleration>{}, Writes<Velocity>{}, noop);
+  auto heal = sched.add("heal", Reads<>{}, Writes<Health>{}, noop);
+  auto draw = sched.add_main("draw", Reads<Position, Health>{}, Writes<>{},
+                             noop);
+  auto read_pos = sched.add("read_pos", Reads<Position>{}, Writes<>{}, noop);
+
+  // write-after-read on Velocity orders accel after move
+  assert(sched.depends_on(accel, move));
+  // disjoint access: no edge
+  assert(!sched.depends_on(heal, move));
+  assert(!sched.depends_on(heal, accel));
+  // draw reads what move and heal write
+  assert(sched.depends_on(draw, move));
+  assert(sched.depends_on(draw, heal));
+  assert(!sched.depends_on(draw, accel));
+  // two readers never conflict
+  assert(!sched.depends_on(read_pos, draw));
+  assert(sched.depends_on(read_pos, move));
+
+  // disabling a system removes its edges
+  sched.set_enabled(move, false);
+  assert(!sched.depends_on(accel, move));
+  assert(!sched.depends_on(read_pos, move));
+}
+
+TEST(test_scheduler_run_order_and_threads) {
+  ECS ecs;
+  JobSystem jobs(4);
+  Scheduler sched;
+
+  std::mutex log_mutex;
+  std::vector<int> log;
+  auto record = [&](int id) {
+    std::lock_guard<std::mutex> lk(log_mutex);
+    log.push_back(id);
+  };
+  const std::thread::id main_id = std::this_thread::get_id();
+  std::atomic<bool> main_ok{true};
+
+  for (int i = 0; i < 100; i++) {
+    Entity e = ecs.create_entity();
+    ecs.add<Position>(e, 0.f, 0.f);
+    ecs.add<Velocity>(e, 1.f, 2.f);
+  }
+
+  sched.add("integrate", Reads<Velocity>{}, Writes<Position>{},
+            [&](ECS &w, float dt) {
+              w.view<Position, Velocity>(
+                  [&](Entity, Position &p, Velocity &v) {
+                    p.x += v.vx * dt;
+                    p.y += v.vy * dt;
+                  });
+              record(0);
+            });
+  sched.add("heal", Reads<>{}, Writes<Health>{},
+            [&](ECS &, float) { record(1); });
+  sched.add_main("render", Reads<Position>{}, Writes<>{},
+                 [&](ECS &w, float) {
+                   if (std::this_thread::get_id() != main_id)
+                     main_ok = false;
+                   w.view<const Position>([&](Entity, const Position &p) {
+                     if (p.x != 1.f || p.y != 2.f)
+                       main_ok = false;
+                   });
+                   // stats of the previous frame, complete for every system
+                   for (const Scheduler::Timing &t : sched.timings())
+                     if (t.runs != sched.timings()[0].runs)
+                       main_ok = false;
+                   record(2);
+                 });
+
+  sched.run(ecs, 1.f, jobs);
+  assert(main_ok);
+  assert(log.size() == 3);
+  // render must come after integrate
+  size_t integrate_at = 0, render_at = 0;
+  for (size_t i = 0; i < log.size(); i++) {
+    if (log[i] == 0)
+      integrate_at = i;
+    if (log[i] == 2)
+      render_at = i;
+  }
+  assert(integrate_at < render_at);
+
+  // declared but never-added types get a storage before systems run
+  assert(ecs.component_id<Health>() == 2);
+
+  for (int frame = 0; frame < 50; frame++)
+    sched.run(ecs, 0.f, jobs);
+  for (const Scheduler::Timing &t : sched.timings()) {
+    assert(t.runs == 51);
+    assert(t.total_ms >= t.last_ms);
+  }
+}
+
+TEST(test_scheduler_exclusive) {
+  ECS ecs;
+  JobSystem jobs(3);
+  Scheduler sched;
+  std::atomic<int> running{0};
+  std::atomic<bool> alone{true};
+
+  auto body = [&](ECS &, float) {
+    running++;
+    std::this_thread::yield();
+    running--;
+  };
+  sched.add("a", Reads<Position>{}, Writes<>{}, body);
+  sched.add("b", Reads<Velocity>{}, Writes<>{}, body);
+  auto spawn = sched.add_exclusive("spawn", [&](ECS &w, float) {
+    if (running != 0)
+      alone = false;
+    Entity e = w.create_entity();
+    w.add<Position>(e, 0.f, 0.f);
+  });
+  sched.add("c", Reads<Health>{}, Writes<>{}, body);
+
+  assert(sched.depends_on(spawn, 0) && sched.depends_on(spawn, 1));
+  assert(sched.depends_on(3, spawn));
+  for (int frame = 0; frame < 20; frame++)
+    sched.run(ecs, 0.f, jobs);
+  assert(alone);
+}
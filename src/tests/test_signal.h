@@ -0,0 +1,70 @@
+#pragma once
+#include "../engine/signal.h"
+#include "test_lib.h"
+
+#include <cassert>
+#include <vector>
+
+// ------------------------------------------------------------
+// TESTS
+// ------------------------------------------------------------
+static int signal_free_calls = 0;
+static void signal_free_fn(int v) { signal_free_calls += v; }
+
+struct SignalCounter {
+  int total = 0;
+  void add(int v) { total += v; }
+};
+
+TEST(test_delegate_bindings) {
+  Delegate<int(int, int)> d;
+  assert(!d);
+  auto mul = [](int a, int b) { return a * b; };
+  d.connect(mul);
+  assert(d && d(6, 7) == 42);
+
+  Delegate<void(int)> f, g;
+  f.connect<&signal_free_fn>();
+  g.connect<&signal_free_fn>();
+  assert(f == g);
+  signal_free_calls = 0;
+  f(3);
+  assert(signal_free_calls == 3);
+
+  SignalCounter a, b;
+  f.connect<&SignalCounter::add>(a);
+  g.connect<&SignalCounter::add>(b);
+  assert(f != g); // same function, other instance
+  f(5);
+  assert(a.total == 5 && b.total == 0);
+  f.reset();
+  assert(!f);
+  static_assert(sizeof(Delegate<void(int)>) == 2 * sizeof(void *));
+}
+
+TEST(test_signal_connect_publish_disconnect) {
+  Signal<void(int)> sig;
+  assert(sig.empty());
+  SignalCounter a, b;
+  std::vector<int> order;
+  auto log = [&](int v) { order.push_back(v); };
+
+  sig.connect<&SignalCounter::add>(a);
+  sig.connect<&SignalCounter::add>(b);
+  sig.connect(log);
+  sig.connect<&signal_free_fn>();
+  assert(sig.size() == 4);
+  signal_free_calls = 0;
+  sig.publish(2);
+  assert(a.total == 2 && b.total == 2 && signal_free_calls == 2);
+  assert(order.size() == 1 && order[0] == 2);
+
+  sig.disconnect<&SignalCounter::add>(a);
+  sig.disconnect(log);
+  sig.publish(1);
+  assert(a.total == 2 && b.total == 3 && order.size() == 1);
+  sig.disconnect<&signal_free_fn>();
+  assert(sig.size() == 1);
+  sig.clear();
+  assert(sig.empty());
+}
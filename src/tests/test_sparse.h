@@ -1,7 +1,10 @@
 #pragma once
 #include <algorithm>
 #include <cassert>
+#include <memory>
 #include <random>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
 #include "../engine/sparse_set.h"
@@ -96,3 +99,362 @@ TEST(test_sparse_random_iteration) {
 
   assert(seen.size() == N);
 }
+
+TEST(test_sparse_insert_bulk) {
+  SparseSet<uint32_t, int> s;
+  s.insert(3, 30);
+
+  std::vector<int> keys;
+  std::vector<uint32_t> values;
+  for (int i = 0; i < 10000; i++) {
+    keys.push_back(i * 7 % 10007);
+    values.push_back(i);
+  }
+  s.insert_bulk(keys.data(), values.data(), keys.size());
+
+  assert(s.size() == keys.size());
+  for (size_t i = 0; i < keys.size(); i++)
+    assert(s.contains(keys[i]) && s.get(keys[i]) == values[i]);
+}
+
+TEST(test_sparse_insert_bulk_repeats) {
+  // a repeated id is inserted once and keeps its last value
+  SparseSet<int, uint32_t> s;
+  const uint32_t keys[] = {7, 2000000, 7, 9};
+  const int values[] = {1, 2, 3, 4};
+  s.insert_bulk(keys, values, 4);
+  assert(s.size() == 3 && s.get(7) == 3 && s.get(2000000) == 2);
+  assert(s.get(9) == 4);
+
+  EntitySet<uint32_t> e;
+  e.insert_bulk(keys, 4);
+  assert(e.size() == 3 && e.contains(7) && e.contains(2000000));
+  // only the two pages holding the ids were allocated
+  assert(e.sparse_bytes() == 2 * 2048 * sizeof(uint32_t));
+}
+
+// Counts copies so tests can check that values are moved, not copied.
+struct CopyCounter {
+  static inline int copies = 0;
+  std::string payload;
+  explicit CopyCounter(std::string s) : payload(std::move(s)) {}
+  CopyCounter(const CopyCounter &o) : payload(o.payload) { copies++; }
+  CopyCounter(CopyCounter &&) = default;
+  CopyCounter &operator=(const CopyCounter &o) {
+    payload = o.payload;
+    copies++;
+    return *this;
+  }
+  CopyCounter &operator=(CopyCounter &&) = default;
+};
+
+TEST(test_sparse_emplace_and_move) {
+  SparseSet<CopyCounter, uint32_t> s;
+  CopyCounter::copies = 0;
+  for (uint32_t i = 0; i < 100; i++)
+    s.emplace(i, std::string(40, char('a' + i % 26)));
+  s.emplace(5, "replaced");
+  for (uint32_t i = 0; i < 100; i += 3)
+    s.erase(i); // swap-remove moves the last element into the hole
+  s.insert(200, CopyCounter("moved in"));
+  assert(CopyCounter::copies == 0);
+  assert(s.get(5).payload == "replaced" && s.get(200).payload == "moved in");
+  assert(s.get(7).payload == std::string(40, 'h'));
+
+  // move-only values and aggregates
+  SparseSet<std::unique_ptr<int>, uint32_t> owned;
+  owned.emplace(1, new int(10));
+  owned.emplace(2, std::make_unique<int>(20));
+  owned.erase(1);
+  assert(*owned.get(2) == 20 && owned.size() == 1);
+  struct Pair {
+    int a, b;
+  };
+  SparseSet<Pair, uint32_t> pairs;
+  assert(pairs.emplace(4, 1, 2).b == 2);
+
+  // a throwing constructor leaves the set as it was
+  struct Picky {
+    explicit Picky(int v) : v(v) {
+      if (v < 0)
+        throw std::invalid_argument("negative");
+    }
+    int v;
+  };
+  SparseSet<Picky, uint32_t> picky;
+  picky.emplace(1, 1);
+  bool threw = false;
+  try {
+    picky.emplace(2, -1);
+  } catch (const std::invalid_argument &) {
+    threw = true;
+  }
+  assert(threw && !picky.contains(2) && picky.size() == 1);
+  picky.emplace(2, 2);
+  assert(picky.get(2).v == 2 && picky.get(1).v == 1);
+}
+
+TEST(test_paged_set_growth_and_holes) {
+  // growth never moves components
+  PagedSet<uint64_t, uint32_t, 64, false> grow;
+  uint64_t *first = &grow.insert(0, 7);
+  for (uint32_t i = 1; i < 10000; i++)
+    grow.insert(i, i);
+  assert(first == &grow.get(0) && *first == 7);
+  grow.erase(0); // swap-remove: the last component moves into slot 0
+  assert(!grow.contains(0) && grow.get(9999) == 9999);
+  assert(grow.size() == 9999 && grow.entities().size() == 9999);
+
+  // in-place delete: nothing moves, holes are reused
+  CopyCounter::copies = 0;
+  PagedSet<CopyCounter, uint32_t, 16, true> stable;
+  std::vector<const CopyCounter *> addr;
+  for (uint32_t i = 0; i < 100; i++)
+    addr.push_back(&stable.emplace(i, std::to_string(i)));
+  for (uint32_t i = 0; i < 100; i += 2)
+    stable.erase(i);
+  assert(stable.size() == 50 && stable.entities().size() == 100);
+  for (uint32_t i = 1; i < 100; i += 2)
+    assert(&stable.get(i) == addr[i] && stable.get(i).payload ==
+                                            std::to_string(i));
+  assert(stable.entities()[0] == (PagedSet<CopyCounter, uint32_t, 16,
+                                           true>::TOMBSTONE));
+  int visited = 0;
+  stable.for_each([&](uint32_t e, CopyCounter &c) {
+    assert(e % 2 == 1 && c.payload == std::to_string(e));
+    visited++;
+  });
+  assert(visited == 50);
+
+  const CopyCounter *reused = &stable.emplace(500, "new");
+  assert(reused == addr[98]); // most recent hole first
+  assert(stable.size() == 51 && stable.entities().size() == 100);
+  assert(CopyCounter::copies == 0);
+}
+
+TEST(test_sparse_page_reclaim_and_pool) {
+  using Set = SparseSet<int>;
+  const size_t page_bytes = sizeof(uint32_t) * Set::SPARSE_SET_PAGE_SIZE;
+  SparsePagePool<uint32_t> pool;
+  Set a, b;
+  a.use_pool(&pool);
+  b.use_pool(&pool);
+
+  // two pages in a; emptying the second gives it to the pool at once
+  for (uint32_t i = 0; i < 4096; i++)
+    a.insert(i, int(i));
+  assert(a.sparse_bytes() == 2 * page_bytes);
+  for (uint32_t i = 2048; i < 4096; i++)
+    a.erase(i);
+  assert(a.sparse_bytes() == page_bytes);
+  assert(pool.pooled_bytes() == page_bytes);
+  assert(a.reclaimed_bytes() == page_bytes);
+  for (uint32_t i = 0; i < 2048; i++)
+    assert(a.get(i) == int(i));
+  assert(!a.contains(3000));
+
+  // b reuses the pooled page, which comes back all INVALID
+  b.insert(100000, 1);
+  assert(pool.pooled_bytes() == 0);
+  assert(b.contains(100000) && !b.contains(100001) && !b.contains(99999));
+
+  // shrink_to_fit trims the dense arrays to their contents
+  for (uint32_t i = 100; i < 2048; i++)
+    a.erase(i);
+  const size_t dense_before = a.dense_bytes();
+  assert(a.shrink_to_fit() > 0);
+  assert(a.dense_bytes() < dense_before && a.size() == 100);
+  for (uint32_t i = 0; i < 100; i++)
+    assert(a.get(i) == int(i));
+
+  // without a pool, emptied pages go straight back to malloc
+  Set solo;
+  solo.insert(5000, 1);
+  solo.erase(5000);
+  assert(solo.sparse_bytes() == 0 && !solo.contains(5000));
+  solo.insert(5000, 2);
+  assert(solo.get(5000) == 2);
+
+  // reserve() allocates only the pages its ids land on; those that never
+  // got an entry are released by shrink_to_fit
+  EntitySet<uint32_t> reserved;
+  const uint32_t far[] = {3 * 2048, 3 * 2048 + 1, 2000000};
+  reserved.reserve(far, 3);
+  assert(reserved.sparse_bytes() == 2 * page_bytes);
+  reserved.shrink_to_fit();
+  assert(reserved.sparse_bytes() == 0);
+}
+
+#ifdef RECS_MAPPED_SPARSE
+TEST(test_sparse_mapped_backend) {
+  using Set = SparseSet<int, uint32_t, MappedEntitySet<uint32_t>>;
+  Set s;
+
+  // ids at both ends of the range; untouched slots read as absent
+  const uint32_t far = 0xFFFFFFFEu;
+  s.insert(0, 1);
+  s.insert(far, 2);
+  s.insert(123456789, 3);
+  assert(s.size() == 3 && !s.contains(1) && !s.contains(far - 1));
+  assert(s.get(0) == 1 && s.get(far) == 2 && s.get(123456789) == 3);
+
+  // swap-remove keeps the moved entity reachable
+  s.erase(0);
+  assert(!s.contains(0) && s.get(123456789) == 3 && s.get(far) == 2);
+  s.insert(0, 4);
+  assert(s.get(0) == 4);
+
+  // same behaviour as the paged table under random churn
+  SparseSet<int> ref;
+  Set m;
+  std::mt19937 rng(7);
+  for (int i = 0; i < 20000; i++) {
+    const uint32_t e = rng() % 50000;
+    if (rng() & 1) {
+      ref.insert(e, i);
+      m.insert(e, i);
+    } else {
+      ref.erase(e);
+      m.erase(e);
+    }
+  }
+  assert(ref.size() == m.size());
+  for (uint32_t e = 0; e < 50000; e++) {
+    assert(ref.contains(e) == m.contains(e));
+    if (ref.contains(e))
+      assert(ref.get(e) == m.get(e));
+  }
+
+  // emptied OS pages go back to the kernel and read as absent afterwards
+  for (uint32_t e : std::vector<uint32_t>(m.entities()))
+    m.erase(e);
+  assert(m.sparse_bytes() > 0);
+  assert(m.shrink_to_fit() > 0 && m.sparse_bytes() == 0);
+  assert(!m.contains(100) && m.size() == 0);
+  m.insert(100, 5);
+  assert(m.get(100) == 5);
+
+  // bulk inserts on fresh pages count them like single inserts do
+  Set b;
+  std::vector<uint32_t> ids;
+  std::vector<int> vals;
+  for (uint32_t i = 0; i < 5000; i++) {
+    ids.push_back(i * 7);
+    vals.push_back(int(i));
+  }
+  b.insert_bulk(ids.data(), vals.data(), ids.size());
+  assert(b.size() == ids.size() && b.get(7 * 4999) == 4999);
+  for (uint32_t e : ids)
+    b.erase(e);
+  assert(b.sparse_bytes() > 0);
+  assert(b.shrink_to_fit() > 0 && b.sparse_bytes() == 0);
+  assert(!b.contains(7) && b.size() == 0);
+}
+#endif
+
+TEST(test_sparse_batched_lookup) {
+  SparseSet<int> s;
+  for (uint32_t i = 0; i < 10000; i += 3)
+    s.insert(i, int(i) * 2);
+  s.insert(1u << 20, 7); // lone page far away
+
+  // shuffled mix of present ids, absent ids and ids on unallocated pages
+  std::vector<uint32_t> keys;
+  for (uint32_t i = 0; i < 12000; i++)
+    keys.push_back(i);
+  keys.push_back(1u << 20);
+  keys.push_back(1u << 25);
+  std::mt19937 rng(11);
+  std::shuffle(keys.begin(), keys.end(), rng);
+
+  std::vector<int *> out(keys.size());
+  std::unique_ptr<bool[]> in(new bool[keys.size()]);
+  s.get_batch(keys, out.data());
+  s.contains_batch(keys, in.get());
+  for (size_t i = 0; i < keys.size(); i++) {
+    assert(in[i] == s.contains(keys[i]));
+    assert((out[i] != nullptr) == s.contains(keys[i]));
+    if (out[i])
+      assert(out[i] == &s.get(keys[i]));
+  }
+
+  // batches shorter than the prefetch distance
+  int *one[1];
+  s.get_batch(Span<const uint32_t>(keys.data(), 1), one);
+  assert((one[0] != nullptr) == s.contains(keys[0]));
+}
+
+TEST(test_sparse_bulk_lookup_kernels) {
+  SparseSet<int> s;
+  std::mt19937 rng(3);
+  for (uint32_t i = 0; i < 20000; i++)
+    if (rng() % 3 == 0)
+      s.insert(i, int(i));
+  s.insert(0xFFFFFFF0u, 1); // page index past 2^20, ids past 2^31
+  for (uint32_t i = 0; i < 20000; i += 7)
+    s.erase(i); // stale dense slots behind swap-removes
+
+  // present, absent, unallocated pages, past the page table; odd tail
+  std::vector<uint32_t> keys;
+  for (uint32_t i = 0; i < 25000; i++)
+    keys.push_back(rng() % 2 ? i : rng());
+  keys.push_back(0xFFFFFFF0u);
+  keys.push_back(0xFFFFFFF1u);
+  keys.push_back(0x80000000u);
+
+  std::vector<uint32_t> idx(keys.size());
+  std::unique_ptr<bool[]> in(new bool[keys.size()]);
+  s.index_of_many(keys, idx.data());
+  s.contains_many(keys, in.get());
+  std::vector<uint32_t> expected;
+  for (size_t i = 0; i < keys.size(); i++) {
+    const bool present = s.contains(keys[i]);
+    assert(in[i] == present);
+    assert(idx[i] == (present ? s.index_of(keys[i]) : SparseSet<int>::INVALID));
+    if (present)
+      expected.push_back(keys[i]);
+  }
+
+  // filter in place, as group construction does
+  std::vector<uint32_t> kept(keys);
+  kept.resize(s.filter(kept, kept.data()));
+  assert(kept == expected);
+
+  SparseSet<int> empty;
+  assert(empty.filter(keys, kept.data()) == 0);
+}
+
+TEST(test_sparse_filter_kernels_agree) {
+  // a hand-built table: pages 0 and 2, page 1 unallocated, and a stale
+  // slot (id 9) whose dense entry belongs to another id
+  using namespace sparse_filter;
+  std::vector<uint32_t> page0(2048, Table::INVALID);
+  std::vector<uint32_t> page2(2048, Table::INVALID);
+  const uint32_t dense[] = {5, 4100, 7, 4097};
+  page0[5] = 0;
+  page0[7] = 2;
+  page0[9] = 1;
+  page2[4] = 1;
+  page2[1] = 3;
+  const uint32_t *pages[] = {page0.data(), nullptr, page2.data()};
+  const Table t{pages, 3, dense};
+
+  std::vector<uint32_t> ids;
+  for (uint32_t i = 0; i < 4200; i++)
+    ids.push_back(i);
+  ids.push_back(0xFFFFFFFFu);
+  ids.push_back(6144 + 5);
+
+  std::vector<uint32_t> want(ids.size()), got(ids.size());
+  lookup_many(t, ids.data(), ids.size(), want.data(), Kernel::SCALAR);
+  assert(want[5] == 0 && want[4100] == 1 && want[9] == Table::INVALID);
+  // every kernel this CPU runs gives the scalar answer
+  for (int k = 0; k <= int(kernel()); k++) {
+    lookup_many(t, ids.data(), ids.size(), got.data(), Kernel(k));
+    assert(got == want);
+    const size_t n =
+        filter_present(t, ids.data(), ids.size(), got.data(), Kernel(k));
+    assert(n == 4 && got[0] == 5 && got[1] == 7 && got[2] == 4097 &&
+           got[3] == 4100);
+  }
+}
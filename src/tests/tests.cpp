@@ -1,9 +1,16 @@
 // g++ -std=c++17 -O3 -DRUN_TESTS -march=native -o tests tests.cpp && ./tests
 #include "test_lib.h"
 
+#include "bench_archetype.h"
 #include "bench_ecs.h"
+#include "bench_jobs.h"
 #include "bench_sparse.h"
+#include "test_archetype.h"
+#include "test_command_buffer.h"
 #include "test_ecs.h"
+#include "test_job_system.h"
+#include "test_scheduler.h"
+#include "test_signal.h"
 #include "test_sparse.h"
 
 #ifdef RUN_TESTS